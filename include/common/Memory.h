@@ -59,6 +59,22 @@ namespace XS
 	*	and align up to the pages' end
 	*/
 	bool DecommitMemoryPage( void* pAddress, size_t nSize );
+
+	/**
+	* @brief Map the whole file into memory as read only pages
+	* @param [in] szFileName name of the file needed to be mapped
+	* @param [out] nSize size of the mapped file
+	* @return begin address of the mapped memory, NULL if failed
+	* @note empty file can not be mapped
+	*/
+	void* MapFileToMemory( const char* szFileName, size_t& nSize );
+
+	/**
+	* @brief Unmap the file mapped by MapFileToMemory
+	* @param [in] pAddress address returned by MapFileToMemory
+	* @param [in] nSize size returned by MapFileToMemory
+	*/
+	bool UnmapFileFromMemory( void* pAddress, size_t nSize );
 }
 
 #endif
@@ -0,0 +1,66 @@
+﻿/**@file  		UtfConvert.h
+* @brief		UTF-8/UTF-16/UCS transcoder
+* @author		Daphnis Kau
+* @date			2019-06-24
+* @version		V1.0
+*/
+
+#ifndef __XS_UTF_CONVERT_H__
+#define __XS_UTF_CONVERT_H__
+
+#include "common/CommonType.h"
+#include <stddef.h>
+
+namespace XS
+{
+	/**
+	* @brief Convert utf8 string to wchar_t string
+	* @param [out] szDes destination buffer, at least nLen + 1 elements
+	* @param [in] szSrc source utf8 string
+	* @param [in] nLen byte count of szSrc
+	* @return count of wchar_t written, not include the terminating 0
+	* @note invalid sequence will be replaced by U+FFFD, 
+	*	surrogate pairs are produced when wchar_t is 16 bits
+	*/
+	size_t Utf8ToUcs( wchar_t* szDes, const char* szSrc, size_t nLen );
+
+	/**
+	* @brief Convert wchar_t string to utf8 string
+	* @param [out] szDes destination buffer, at least nLen*4 + 1 bytes
+	* @param [in] szSrc source wchar_t string
+	* @param [in] nLen wchar_t count of szSrc
+	* @return byte count written, not include the terminating 0
+	*/
+	size_t UcsToUtf8( char* szDes, const wchar_t* szSrc, size_t nLen );
+
+	/**
+	* @brief Convert utf16 string to utf8 string
+	* @param [out] szDes destination buffer, at least nLen*3 + 1 bytes
+	* @param [in] szSrc source utf16 string
+	* @param [in] nLen uint16 count of szSrc
+	* @return byte count written, not include the terminating 0
+	*/
+	size_t Utf16ToUtf8( char* szDes, const uint16* szSrc, size_t nLen );
+
+	/**
+	* @brief Convert utf16 string to wchar_t string
+	* @param [out] szDes destination buffer, at least nLen + 1 elements
+	* @param [in] szSrc source utf16 string
+	* @param [in] nLen uint16 count of szSrc
+	* @return count of wchar_t written, not include the terminating 0
+	* @note szSrc may be stored in the tail of szDes to convert in place, 
+	*	starting at ( (uint16*)szDes ) + nLen + 1
+	*/
+	size_t Utf16ToUcs( wchar_t* szDes, const uint16* szSrc, size_t nLen );
+
+	/**
+	* @brief Convert wchar_t string to utf16 string
+	* @param [out] szDes destination buffer, at least nLen*2 + 1 elements
+	* @param [in] szSrc source wchar_t string
+	* @param [in] nLen wchar_t count of szSrc
+	* @return count of uint16 written, not include the terminating 0
+	*/
+	size_t UcsToUtf16( uint16* szDes, const wchar_t* szSrc, size_t nLen );
+}
+
+#endif
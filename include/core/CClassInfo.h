@@ -16,12 +16,14 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 
 namespace XS
 {
 	class CTypeBase;
 	class CScriptBase;
 	class CCallInfo;
+	class CMemberInfo;
 	class CCallbackInfo;
 	class CClassInfo;
 	class CGlobalClassRegist;
@@ -35,6 +37,14 @@ namespace XS
 			const CClassInfo*			m_pBaseInfo;        // Base class information
 			int32						m_nBaseOff;         // Base class offset
 		};
+	public:
+		struct SFieldInfo
+		{
+			const CMemberInfo*			m_pMember;			// Registered data member
+			int32						m_nBaseOff;         // Offset of the class owning the member
+		};
+		typedef std::vector<SFieldInfo>	CFieldArray;
+	private:
 
 		const_string					m_szClassName;		// Name of class
 		const_string					m_szTypeIDName;		// typeid of the class
@@ -47,6 +57,11 @@ namespace XS
 		uint32							m_nSizeOfClass;
 		uint32							m_nAligenSizeOfClass;
 		bool							m_bIsEnum;
+		bool							m_bIsPod;			// Trivially copyable value class
+		bool							m_bTableConvert;	// Convertible with plain table/object
+		mutable std::once_flag			m_FieldOnce;
+		mutable CFieldArray				m_vecField;			// Data members of the class and its bases
+		mutable size_t					m_nFieldBufferSize;	// Buffer size enough for any member value
 		uint8							m_nInheritDepth;
 		CCallBaseMap					m_mapRegistFunction;
 		
@@ -60,7 +75,8 @@ namespace XS
 
 		static const CClassInfo*		RegisterClass( const char* szClassName, const char* szTypeIDName, uint32 nSize, bool bEnum );
 		static const CClassInfo*		GetClassInfo( const char* szTypeInfoName );
-		static const CClassInfo*		SetObjectConstruct( const char* szTypeInfoName, IObjectConstruct* pObjectConstruct );
+		static const CClassInfo*		SetObjectConstruct( const char* szTypeInfoName, IObjectConstruct* pObjectConstruct, bool bPod );
+		static const CClassInfo*		EnableTableConvert( const char* szTypeInfoName );
 		static const CClassInfo*		AddBaseInfo( const char* szTypeInfoName, const char* szBaseTypeInfoName, ptrdiff_t nOffset );
 		static const CCallInfo*			RegisterFunction( const char* szTypeInfoName, CCallInfo* pCallBase );
 		static const CCallInfo*			RegisterCallBack( const char* szTypeInfoName, uint32 nIndex, CCallbackInfo* pCallScriptBase );
@@ -82,6 +98,21 @@ namespace XS
         bool                            FindBase( const CClassInfo* pRegistBase ) const;
 		bool							IsBaseObject(ptrdiff_t nDiff) const;
 		bool							IsEnum() const { return m_bIsEnum; }
+		bool							IsPod() const { return m_bIsPod; }
+		bool							IsTableConvert() const { return m_bTableConvert; }
+		/**
+		* @brief Registered data members of the class and all its bases, 
+		*	members of the derived class hide the ones of the same name in bases
+		*/
+		const CFieldArray&				GetFields() const;
+		/**
+		* @brief Buffer size enough to hold the value of any data member
+		*/
+		size_t							GetFieldBufferSize() const;
+		/**
+		* @brief Class info of nType if it is a table convertible value class, otherwise NULL
+		*/
+		static const CClassInfo*		GetConvertibleClass( DataType nType );
 		const std::vector<SBaseInfo>&  	BaseRegist() const { return m_vecBaseRegist; }
 		const const_string&            	GetTypeIDName() const { return m_szTypeIDName; }
 		const const_string&            	GetClassName() const { return m_szClassName; }
@@ -18,6 +18,7 @@
 #include <set>
 #include <thread>
 #include <mutex>
+#include <atomic>
 
 namespace XS
 {
@@ -80,8 +81,9 @@ namespace XS
 		CScriptBase*		m_pBase;
 		std::thread			m_hThread;
 		std::mutex			m_hCmdLock;
-		intptr_t			m_nRemoteListener;
-		intptr_t			m_nRemoteConnecter;
+		std::atomic<intptr_t>	m_nRemoteListener;	// 监听线程也在读写
+		std::atomic<intptr_t>	m_nRemoteConnecter;
+		uint16				m_nDebugPort;
 		CDebugCmdList		m_listDebugCmd;
 
 		char*				m_pBuf;
@@ -155,9 +157,16 @@ namespace XS
 		bool				Error( const char* szException, bool bBeCaught );
 		void				BTrace( int32 nFrameCount );
 		void				AddFileContent( const char* szSource, const char* szData );
+		void				RemoveFileContent( const char* szSource );
 		bool				RemoteDebugEnable() const;
 		bool				RemoteCmdValid() const { return !m_listDebugCmd.IsEmpty(); }
 		void				CheckEnterRemoteDebug();
+		/**
+		* @brief Stop the listening thread before fork, fail if a client is attached
+		*/
+		bool				StopRemote();
+		void				RestartRemote( uint16 nDebugPort );
+		uint16				GetDebugPort() const { return m_nDebugPort; }
 
 		virtual uint32		AddBreakPoint( const char* szFileName, int32 nLine );
 		virtual void		DelBreakPoint( uint32 nBreakPointID );
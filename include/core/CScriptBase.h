@@ -10,6 +10,7 @@
 #include "common/TList.h"
 #include "CClassInfo.h"
 #include <stdarg.h>
+#include <chrono>
 #include <vector>
 #include <list>
 #include <map>
@@ -19,9 +20,47 @@ namespace XS
 {
 	class CDebugBase;
 	class CCallInfo;
+	class CScriptPackage;
+	class CScriptOutput;
+	class IScriptOutputSink;
+	class CSharedData;
 	typedef std::pair<SFunctionTable*, uint32> CVMObjVTableInfo;
 	typedef std::map<const CClassInfo*, CVMObjVTableInfo> CNewFunctionTableMap;
 	typedef std::map<SFunctionTable*, SFunctionTable*> CFunctionTableMap;
+	typedef std::map<std::string, CScriptPackage*> CScriptPackageMap;
+	typedef std::map<std::string, std::string> CResolvedPathMap;
+
+	struct SLoadedFile
+	{
+		std::string				m_strPath;
+		int64					m_nModifyTime;
+		int64					m_nFileSize;
+	};
+	typedef std::map<std::string, SLoadedFile> CLoadedFileMap;
+
+	struct SRunningString
+	{
+		const_string			m_strContent;
+		uint32					m_nChunkID;
+	};
+	typedef std::list<SRunningString> CRunningStringList;
+	typedef std::map<const_string, CRunningStringList::iterator> CRunningStringMap;
+	typedef std::map<uint32, CRunningStringList::iterator> CRunningChunkMap;
+
+	enum EObjectStat
+	{
+		eObjStat_Bound,		// C++创建，绑定到虚拟机
+		eObjStat_NewByVM,	// 虚拟机创建
+		eObjStat_ValueCopy,	// 值类型的拷贝
+		eObjStat_Count
+	};
+
+	struct SObjectStat
+	{
+		uint32					m_aryCount[eObjStat_Count];
+		uint64					m_nNativeBytes;		// 虚拟机持有的C++内存
+	};
+	typedef std::map<const CClassInfo*, SObjectStat> CObjectStatMap;
 
     class CScriptBase
 	{
@@ -33,13 +72,66 @@ namespace XS
 		CFunctionTableMap		m_mapVirtualTableOld2New;
 		CNewFunctionTableMap	m_mapNewVirtualTable;
 		std::list<std::string>	m_listSearchPath;
-		std::set<const_string>	m_setRuningString;
+		CScriptPackageMap		m_mapSearchPackage;
+		CResolvedPathMap		m_mapResolvedPath;
+		std::set<void*>			m_setFileContext;	// 默认OpenFile打开的文件
+		CLoadedFileMap			m_mapLoadedFile;
+		CRunningStringList		m_listRuningString;
+		CRunningStringMap		m_mapRuningString;
+		CRunningChunkMap		m_mapRuningChunk;
+		uint32					m_nStringCacheSize;
+		uint32					m_nStringChunkID;
+		uint64					m_nStringCacheHit;
+		uint64					m_nStringCacheMiss;
+		CObjectStatMap			m_mapObjectStat;
+		CScriptOutput*			m_pOutput;
+		uint32					m_nExecBudget;
+		uint32					m_nExecDepth;
+		bool					m_bBudgetArmed;
+		bool					m_bBudgetExceeded;
+		std::chrono::steady_clock::time_point m_tBudgetDeadline;
+		IScriptOutputSink*		m_pForkOutputSink;
+		uint32					m_nForkOutputSize;
+		bool					m_bForkPrepared;
+
+		class CBudgetGuard
+		{
+			CScriptBase*		m_pScript;
+		public:
+			CBudgetGuard( CScriptBase* pScript ) : m_pScript( pScript ) { pScript->EnterExecution(); }
+			~CBudgetGuard() { m_pScript->LeaveExecution(); }
+		};
+		void					EnterExecution();
+		void					LeaveExecution();
+		bool					CheckBudget();
+		/**
+		* @brief Start/stop enforcing the budget of the outermost script call
+		*/
+		virtual void			BeginBudget();
+		virtual void			EndBudget();
 
 		virtual bool			CallVM( const CCallbackInfo* pCallBase, void* pRetBuf, void** pArgArray ) = 0;
 		virtual void			DestrucVM( const CCallbackInfo* pCallBase, SVirtualObj* pObject ) = 0;
 
 		virtual bool        	RunFunction( const STypeInfoArray& aryTypeInfo, void* pResultBuf, const char* szFunction, void** aryArg ) = 0;
 		virtual bool        	RunBuffer( const void* pBuffer, size_t nSize, const char* szFileName ) = 0;
+		bool					RunScriptFile( const char* szFileName, bool& bFileExist );
+		void					ClipStringCache( uint32 nMaxCount );
+		/**
+		* @brief Release the compiled chunk of a string evicted from the RunString cache
+		*/
+		virtual void			ReleaseChunk( const char* szChunkName );
+		void					AddObjectStat( const CClassInfo* pInfo, EObjectStat eType, int32 nDelta );
+		void					RecordLoadedFile( const char* szFileName, const char* szPath );
+		/**
+		* @brief Hooks of ReloadChangedFiles, the VM merges the reloaded classes 
+		*	into the existing ones in EndReload
+		* @note Lua merges the classes stored in _G or package.loaded, either as a
+		*	module or as a field of a module table; classes kept only in locals are not merged
+		*/
+		virtual void			BeginReload();
+		virtual void			EndReload();
+		virtual bool			ReloadFile( const char* szFileName );
     public:
         CScriptBase(void);
 		virtual ~CScriptBase( void );
@@ -54,9 +146,10 @@ namespace XS
 									const STypeInfoArray& aryTypeInfo, const char* szMemberName );
 		static bool				RegisterDestructor( IFunctionWrap* funWrap, uintptr_t funBoot, 
 									uint32 nFunIndex, const STypeInfoArray& aryTypeInfo );
-		static bool				RegisterConstruct( IObjectConstruct* pObjectConstruct, const char* szTypeIDName );
+		static bool				RegisterConstruct( IObjectConstruct* pObjectConstruct, const char* szTypeIDName, bool bPod = false );
 		static bool				RegisterClass( const char* szClass, uint32 nCount, const char** aryType, const ptrdiff_t* aryValue);
 		static bool				RegisterEnum( const char* szTypeIDName, const char* szEnumName, int32 nTypeSize );
+		static bool				RegisterTableConvert( const char* szTypeIDName );
 
 		static void				CallBack( int32 nIndex, void* pRetBuf, void** pArgArray );
 
@@ -66,20 +159,85 @@ namespace XS
         SFunctionTable*			GetOrgVirtualTable( void* pObj );
 		SFunctionTable*     	CheckNewVirtualTable( SFunctionTable* pOldFunTable, const CClassInfo* pClassInfo, bool bNewByVM, uint32 nInheritDepth );
         void                	AddSearchPath( const char* szPath );
+		bool                	AddSearchPackage( const char* szPackage );
+		/**
+		* @brief Forget the resolved path of szFileName, or all of them if szFileName is NULL
+		* @note Call it after files are moved or created in the search paths
+		*/
+		void					ClearPathCache( const char* szFileName = NULL );
 
 		virtual int32			Input( char* szBuffer, int nCount );
 		virtual int32			Output( const char* szBuffer, int nCount );
+		/**
+		* @brief Buffer the default Output and write it to pSink in a background thread
+		* @note Output is dropped while more than nMaxBufferSize bytes are pending, 
+		*	pSink NULL writes to stdout
+		*/
+		void					EnableAsyncOutput( IScriptOutputSink* pSink = NULL, uint32 nMaxBufferSize = 1024*1024 );
+		void					DisableAsyncOutput();
+		void					FlushOutput();
+		/**
+		* @brief Bytes of async output dropped because the buffer was full
+		*/
+		uint64					GetOutputDropSize() const;
 
 		virtual void*			OpenFile( const char* szFileName );
 		virtual int32			ReadFile( void* pContext, char* szBuffer, int32 nCount );
 		virtual void			CloseFile( void* pContext );
+		/**
+		* @brief Get the whole content of an opened file without copying
+		* @note The default only knows the contexts created by the default OpenFile
+		*	and returns NULL for others, so the caller reads them by ReadFile
+		*/
+		virtual const char*		GetFileBuffer( void* pContext, size_t& nSize );
 
+		/**
+		* @brief Expose a frozen CSharedData tree as the read-only global szName
+		* @note Containers are read in place through proxies, nothing is copied
+		*/
+		virtual bool			PublishSharedData( const char* szName, const CSharedData* pData );
+		/**
+		* @brief Encode the global szName with the format of CScriptSerial.h
+		* @note The result is appended to strBuffer, functions and c++ objects fail
+		*/
+		virtual bool			SerializeGlobal( const char* szName, std::string& strBuffer );
+		virtual bool			DeserializeGlobal( const char* szName, const void* pBuffer, size_t nSize );
 		virtual void			UnlinkCppObjFromScript( void* pObj ) = 0;
 		virtual void        	GC() = 0;
 		virtual void        	GCAll() = 0;
 
 		bool        			RunFile( const char* szFileName );
 		bool        			RunString( const char* szString );
+		/**
+		* @brief Run the files loaded by RunFile again if they are modified
+		* @note A file is modified when its modify time or size changes
+		* @return Count of the reloaded files
+		*/
+		uint32					ReloadChangedFiles();
+		/**
+		* @brief Zygote mode: warm the VM up, call PrepareFork, fork(), then call
+		*	AfterFork in both the parent and the child
+		* @note Background threads are stopped before fork and restarted after it,
+		*	so the child never inherits a lock held by a thread it does not have.
+		*	The child listens on nDebugPort, 0 disables its remote debugger.
+		*	Fails while a remote debugger is attached.
+		*/
+		virtual bool			PrepareFork();
+		virtual void			AfterFork( bool bChild, uint16 nDebugPort = 0 );
+		/**
+		* @brief Limit every outermost RunFunction/RunString/RunFile to nMilliseconds, 0 for no limit
+		* @note A call exceeding the budget is aborted and returns false with 
+		*	IsBudgetExceeded() true, the VM remains usable
+		*/
+		void					SetExecutionBudget( uint32 nMilliseconds ) { m_nExecBudget = nMilliseconds; }
+		uint32					GetExecutionBudget() const { return m_nExecBudget; }
+		bool					IsBudgetExceeded() const { return m_bBudgetExceeded; }
+		void					SetStringCacheSize( uint32 nMaxCount );
+		uint32					GetStringCacheSize() const { return m_nStringCacheSize; }
+		uint64					GetStringCacheHit() const { return m_nStringCacheHit; }
+		uint64					GetStringCacheMiss() const { return m_nStringCacheMiss; }
+		SObjectStat				GetObjectStat( const CClassInfo* pInfo );
+		const CObjectStatMap&	GetAllObjectStat();
 
 		template<typename RetType, typename... Param>
 		bool					RunFunction( RetType* pRetBuf, const char* szFun, Param ... p );
@@ -96,6 +254,7 @@ namespace XS
 		void* aryParam[sizeof...( p ) + 1] = { &p ... };
 		static STypeInfo aryInfo[] = { GetTypeInfo<Param>()..., GetTypeInfo<RetType>() };
 		static STypeInfoArray TypeInfo = { aryInfo, sizeof( aryInfo )/sizeof( STypeInfo ) };
+		CBudgetGuard Guard( this );
 		return RunFunction( TypeInfo, pRetBuf, szFun, aryParam );
 	}
 
@@ -106,6 +265,7 @@ namespace XS
 		void* aryParam[sizeof...( p ) + 1] = { &p ... };
 		static STypeInfo aryInfo[] = { GetTypeInfo<Param>()..., GetTypeInfo<void>() };
 		static STypeInfoArray TypeInfo = { aryInfo, sizeof( aryInfo )/sizeof( STypeInfo ) };
+		CBudgetGuard Guard( this );
 		return RunFunction( TypeInfo, nullptr, szFun, aryParam );
 	}
 	
@@ -115,6 +275,14 @@ namespace XS
 		void* pContext = OpenFile( szFileName );
 		if( !pContext )
 			return strBuffer;
+		size_t nSize = 0;
+		const char* pBuffer = GetFileBuffer( pContext, nSize );
+		if( pBuffer )
+		{
+			strBuffer.assign( pBuffer, nSize );
+			CloseFile( pContext );
+			return strBuffer;
+		}
 		char szBuffer[1024];
 		int32 nReadSize = 0;
 		while( ( nReadSize = ReadFile( pContext, szBuffer, 1024 ) ) > 0 )
@@ -0,0 +1,58 @@
+﻿/**@file  		CScriptOutput.h
+* @brief		Buffered script output
+* @author		Daphnis Kau
+* @date			2019-06-24
+* @version		V1.0
+* @note			Output of print/console.log is appended to a buffer in the \n
+*				VM thread and written to the sink by a background thread. \n
+*				Output is dropped while the buffer is full, the VM thread \n
+*				never waits for the sink.
+*/
+
+#ifndef __SCRIPT_OUTPUT_H__
+#define __SCRIPT_OUTPUT_H__
+#include "common/CommonType.h"
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace XS
+{
+	class IScriptOutputSink
+	{
+	public:
+		virtual ~IScriptOutputSink(){}
+		/**
+		* @brief Write a block of output, called in the writer thread
+		*/
+		virtual void			Write( const char* szBuffer, uint32 nSize ) = 0;
+	};
+
+	class CScriptOutput
+	{
+		IScriptOutputSink*		m_pSink;
+		uint32					m_nMaxBufferSize;
+		uint64					m_nDropSize;
+		std::string				m_strBuffer;
+		std::string				m_strWriting;
+		bool					m_bWriting;
+		bool					m_bQuit;
+		std::mutex				m_hLock;
+		std::condition_variable	m_hSignal;
+		std::thread				m_hThread;
+
+		void					Run();
+	public:
+		CScriptOutput( IScriptOutputSink* pSink, uint32 nMaxBufferSize );
+		~CScriptOutput();
+
+		void					Write( const char* szBuffer, uint32 nSize );
+		void					Flush();
+		uint64					GetDropSize() const { return m_nDropSize; }
+		IScriptOutputSink*		GetSink() const { return m_pSink; }
+		uint32					GetMaxBufferSize() const { return m_nMaxBufferSize; }
+	};
+}
+
+#endif
@@ -0,0 +1,83 @@
+﻿/**@file  		CScriptPackage.h
+* @brief		Packed script archive
+* @author		Daphnis Kau
+* @date			2019-06-24
+* @version		V1.0
+* @note			A package is mapped into memory as a whole, the content \n
+*				of the packed files are handed to the VM without copying. \n
+*				Layout of package: \n
+*				SPackageHead | SPackageEntry[nFileCount] | names | datas \n
+*				Entries are sorted by file name for binary search.
+*/
+
+#ifndef __SCRIPT_PACKAGE_H__
+#define __SCRIPT_PACKAGE_H__
+#include "common/CommonType.h"
+#include <string>
+#include <vector>
+
+namespace XS
+{
+	class CScriptPackage
+	{
+	public:
+		enum { ePackageMagic = 0x4B505358, ePackageVersion = 1 };
+
+		struct SPackageHead
+		{
+			uint32				m_nMagic;
+			uint32				m_nVersion;
+			uint32				m_nFileCount;
+			uint32				m_nReserved;
+		};
+
+		struct SPackageEntry
+		{
+			uint32				m_nNameOffset;
+			uint32				m_nNameSize;
+			uint32				m_nDataOffset;
+			uint32				m_nDataSize;
+		};
+
+	private:
+		void*					m_pMapAddress;
+		size_t					m_nMapSize;
+		const SPackageEntry*	m_aryEntry;
+		uint32					m_nFileCount;
+
+		CScriptPackage( const CScriptPackage& );
+		const CScriptPackage& operator= ( const CScriptPackage& );
+	public:
+		CScriptPackage();
+		~CScriptPackage();
+
+		/**
+		* @brief Map a package file into memory
+		* @param [in] szPackage name of the package file
+		* @return true if the package is valid
+		*/
+		bool					Open( const char* szPackage );
+		void					Close();
+
+		/**
+		* @brief Find a file in the package
+		* @param [in] szFileName file name relative to the root of package
+		* @param [out] nSize size of the file
+		* @return content of the file, NULL if not found
+		*/
+		const char*				Find( const char* szFileName, uint32& nSize ) const;
+		uint32					GetFileCount() const { return m_nFileCount; }
+
+		/**
+		* @brief Build a package from files
+		* @param [in] szPackage name of the package file to be written
+		* @param [in] szRootPath root directory of the files
+		* @param [in] vecFiles file names relative to szRootPath, \n
+		*	they are used as the names in the package
+		*/
+		static bool				Build( const char* szPackage, const char* szRootPath, 
+									const std::vector<std::string>& vecFiles );
+	};
+}
+
+#endif
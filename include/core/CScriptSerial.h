@@ -0,0 +1,203 @@
+﻿/**@file  		CScriptSerial.h
+* @brief		Binary encoding of script values
+* @author		Daphnis Kau
+* @date			2019-06-24
+* @version		V1.0
+* @note			The same format is used by every VM, so a value serialized \n
+*				by lua can be deserialized by javascript and vice versa. \n
+*				Layout: version byte, then one value. \n
+*				value  := tag [payload] \n
+*				int    := zigzag varint \n
+*				double := 8 bytes, host order \n
+*				string := varint length, bytes \n
+*				array  := varint count, value * count \n
+*				map    := varint count, ( key value ) * count \n
+*				ref    := varint index of an earlier array or map, \n
+*						  containers are indexed from 0 in the order they start. \n
+*				A container met again is written as a ref, so shared \n
+*				and cyclic structures come back with the same shape.
+*/
+
+#ifndef __SCRIPT_SERIAL_H__
+#define __SCRIPT_SERIAL_H__
+#include "common/CommonType.h"
+#include <string.h>
+#include <string>
+
+namespace XS
+{
+	enum ESerialTag
+	{
+		eSerial_Nil,
+		eSerial_False,
+		eSerial_True,
+		eSerial_Int,
+		eSerial_Double,
+		eSerial_String,
+		eSerial_Array,
+		eSerial_Map,
+		eSerial_Ref,
+		eSerial_Count
+	};
+
+	enum
+	{
+		eSerial_Version = 1,
+		eSerial_MaxDepth = 64,
+	};
+
+	/**
+	* @brief Append the encoded value to a std::string，can be shared with TStrStream
+	*/
+	class CSerialWriter
+	{
+		std::string&			m_strBuffer;
+	public:
+		CSerialWriter( std::string& strBuffer ) 
+			: m_strBuffer( strBuffer ) 
+		{
+			m_strBuffer.push_back( (char)eSerial_Version );
+		}
+
+		void WriteTag( ESerialTag eTag ) 
+		{ 
+			m_strBuffer.push_back( (char)eTag ); 
+		}
+
+		void WriteVarint( uint64 nValue )
+		{
+			while( nValue >= 0x80 )
+			{
+				m_strBuffer.push_back( (char)( ( nValue & 0x7f ) | 0x80 ) );
+				nValue >>= 7;
+			}
+			m_strBuffer.push_back( (char)nValue );
+		}
+
+		void WriteNumber( double fValue )
+		{
+			// 整数按变长编码，大部分数值只需要1~3个字节
+			if( fValue >= -9007199254740992.0 && fValue <= 9007199254740992.0 &&
+				(double)(int64)fValue == fValue && ( fValue != 0 || 1/fValue > 0 ) )
+				return WriteInt( (int64)fValue );
+			WriteTag( eSerial_Double );
+			m_strBuffer.append( (const char*)&fValue, sizeof( fValue ) );
+		}
+
+		void WriteInt( int64 nValue )
+		{
+			WriteTag( eSerial_Int );
+			WriteVarint( ( (uint64)nValue << 1 ) ^ (uint64)( nValue >> 63 ) );
+		}
+
+		void WriteString( const char* szValue, size_t nSize )
+		{
+			WriteTag( eSerial_String );
+			WriteVarint( nSize );
+			m_strBuffer.append( szValue, nSize );
+		}
+
+		void WriteContainer( ESerialTag eTag, uint32 nCount )
+		{
+			WriteTag( eTag );
+			WriteVarint( nCount );
+		}
+
+		void WriteRef( uint32 nIndex )
+		{
+			WriteTag( eSerial_Ref );
+			WriteVarint( nIndex );
+		}
+	};
+
+	class CSerialReader
+	{
+		const tbyte*			m_pCur;
+		const tbyte*			m_pEnd;
+	public:
+		CSerialReader( const void* pBuffer, size_t nSize )
+			: m_pCur( (const tbyte*)pBuffer )
+			, m_pEnd( (const tbyte*)pBuffer + nSize )
+		{
+		}
+
+		bool ReadVersion()
+		{
+			return m_pCur < m_pEnd && *m_pCur++ == eSerial_Version;
+		}
+
+		bool ReadTag( ESerialTag& eTag )
+		{
+			if( m_pCur >= m_pEnd || *m_pCur >= eSerial_Count )
+				return false;
+			eTag = (ESerialTag)*m_pCur++;
+			return true;
+		}
+
+		bool ReadVarint( uint64& nValue )
+		{
+			nValue = 0;
+			for( uint32 nShift = 0; nShift < 64 && m_pCur < m_pEnd; nShift += 7 )
+			{
+				tbyte nByte = *m_pCur++;
+				nValue |= (uint64)( nByte & 0x7f ) << nShift;
+				if( !( nByte & 0x80 ) )
+					return true;
+			}
+			return false;
+		}
+
+		bool ReadInt( int64& nValue )
+		{
+			uint64 nZigzag;
+			if( !ReadVarint( nZigzag ) )
+				return false;
+			nValue = (int64)( ( nZigzag >> 1 ) ^ ( 0 - ( nZigzag & 1 ) ) );
+			return true;
+		}
+
+		bool ReadDouble( double& fValue )
+		{
+			if( m_pEnd - m_pCur < (ptrdiff_t)sizeof( fValue ) )
+				return false;
+			memcpy( &fValue, m_pCur, sizeof( fValue ) );
+			m_pCur += sizeof( fValue );
+			return true;
+		}
+
+		bool ReadString( const char*& szValue, uint32& nSize )
+		{
+			uint64 nLen;
+			if( !ReadVarint( nLen ) || nLen > (uint64)( m_pEnd - m_pCur ) )
+				return false;
+			szValue = (const char*)m_pCur;
+			nSize = (uint32)nLen;
+			m_pCur += nLen;
+			return true;
+		}
+
+		bool ReadCount( uint32& nCount )
+		{
+			// 每个元素至少占一个字节，数量不可能超过剩余长度
+			uint64 nValue;
+			if( !ReadVarint( nValue ) || nValue > (uint64)( m_pEnd - m_pCur ) )
+				return false;
+			nCount = (uint32)nValue;
+			return true;
+		}
+
+		bool ReadRef( uint32& nIndex )
+		{
+			uint64 nValue;
+			if( !ReadVarint( nValue ) || nValue >= 0xffffffff )
+				return false;
+			nIndex = (uint32)nValue;
+			return true;
+		}
+
+		bool IsEnd() const { return m_pCur == m_pEnd; }
+		size_t GetReadSize( const void* pBuffer ) const { return m_pCur - (const tbyte*)pBuffer; }
+	};
+}
+
+#endif
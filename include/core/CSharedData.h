@@ -0,0 +1,89 @@
+﻿/**@file  		CSharedData.h
+* @brief		Immutable data tree shared by VMs
+* @author		Daphnis Kau
+* @date			2019-06-24
+* @version		V1.0
+* @note			The tree is built once in C++, frozen, and then published \n
+*				to any number of VMs, which read it through read-only proxies \n
+*				without copying the containers. The tree is never modified \n
+*				after Freeze, so VMs in different threads can read it at the \n
+*				same time. It must outlive every VM it is published to.
+*/
+
+#ifndef __SHARED_DATA_H__
+#define __SHARED_DATA_H__
+#include "common/CommonType.h"
+#include <string>
+#include <vector>
+
+namespace XS
+{
+	class CSharedData
+	{
+	public:
+		enum EType
+		{
+			eType_Nil,
+			eType_Bool,
+			eType_Number,
+			eType_String,
+			eType_Array,
+			eType_Map,
+		};
+
+	private:
+		typedef std::pair<std::string, CSharedData*> CMapItem;
+
+		EType					m_eType;
+		bool					m_bFrozen;
+		union
+		{
+			bool				m_bValue;
+			double				m_fValue;
+		};
+		std::string				m_strValue;
+		std::vector<CSharedData*> m_vecArray;
+		std::vector<CMapItem>	m_vecMap;
+
+		CSharedData( EType eType );
+		CSharedData( const CSharedData& );
+		const CSharedData& operator= ( const CSharedData& );
+	public:
+		~CSharedData();
+
+		static CSharedData*		NewNil();
+		static CSharedData*		NewBool( bool bValue );
+		static CSharedData*		NewNumber( double fValue );
+		static CSharedData*		NewString( const char* szValue );
+		static CSharedData*		NewArray();
+		static CSharedData*		NewMap();
+
+		/**
+		* @brief Build the tree, the node takes the ownership of pChild
+		*/
+		CSharedData*			Push( CSharedData* pChild );
+		CSharedData*			Insert( const char* szKey, CSharedData* pChild );
+		/**
+		* @brief Sort the keys of all maps in the tree, must be called before publishing
+		*/
+		void					Freeze();
+		bool					IsFrozen() const { return m_bFrozen; }
+
+		EType					GetType() const { return m_eType; }
+		bool					GetBool() const { return m_bValue; }
+		double					GetNumber() const { return m_fValue; }
+		const char*				GetString() const { return m_strValue.c_str(); }
+		uint32					GetStringSize() const { return (uint32)m_strValue.size(); }
+
+		/**
+		* @brief Count of items of an array or a map
+		*/
+		uint32					GetCount() const;
+		const CSharedData*		GetItem( uint32 nIndex ) const;
+		const char*				GetKey( uint32 nIndex ) const;
+		const CSharedData*		Find( const char* szKey ) const;
+		int32					FindIndex( const char* szKey ) const;
+	};
+}
+
+#endif
@@ -36,6 +36,17 @@
 #define DEFINE_ABSTRACT_CLASS_BEGIN( _class, ... ) \
 	DEFINE_CLASS_BEGIN_IMPLEMENT( eConstructType_Abstract, _class, ##__VA_ARGS__)
 
+/**
+* @brief  Register small trivially copyable class passed by value
+* @note	Values are marshalled as compact data without per-object \n
+*	table or __gc and copied by memcpy. Sampler: \n
+*	DEFINE_POD_CLASS_BEGIN( _class )\n
+*		.... \n
+*	DEFINE_CLASS_END()\n
+*/
+#define DEFINE_POD_CLASS_BEGIN( _class ) \
+	DEFINE_CLASS_BEGIN_IMPLEMENT( eConstructType_Pod, _class )
+
 /**
 * @brief  Register the class's virtual destructor
 */
@@ -81,6 +92,14 @@
 #define REGIST_CLASSMEMBER_WITHNAME( _member, _new_name ) \
 	REGIST_CLASSMEMBER_GETSET_IMPLEMENT( _member, _new_name, true, true )
 
+/**
+* @brief  Make the value class convertible with a plain lua table or js object
+* @note	Adds obj:ToTable() and obj:FromTable( tbl ) to the class, both copy \n
+*	every registered data member, including the ones of base classes, in \n
+*	one native call. Members whose class is also convertible are nested.
+*/
+#define REGIST_TABLE_CONVERT() REGIST_TABLE_CONVERT_IMPLEMENT()
+
 /**
 * @brief  Register global function
 */
@@ -34,7 +34,8 @@
 	static XS::SGlobalExe _class_fun_register( listRegister.GetFirst()->Register() ); \
 	typedef TConstruct<org_class, _last, ConstructParamsType, eConstructType> ConstructType; \
 	static XS::SGlobalExe _class_construct_register( \
-	XS::CScriptBase::RegisterConstruct( ConstructType::Inst(), typeid( org_class ).name() ) ); } }
+	XS::CScriptBase::RegisterConstruct( ConstructType::Inst(), typeid( org_class ).name(), \
+	eConstructType == eConstructType_Pod ) ); } }
 
 
 #define REGIST_CONSTRUCTOR( ... )\
@@ -162,6 +163,16 @@
 	typedef destructor_Base_Class
 
 
+#define REGIST_TABLE_CONVERT_IMPLEMENT() \
+	table_convert_Base_Class; \
+	namespace table_convert_namespace \
+	{ \
+		static void Register() { XS::CScriptBase::RegisterTableConvert( typeid( org_class ).name() ); } \
+		static XS::CScriptRegisterNode RegisterNode( listRegister, &Register ); \
+	};  \
+	typedef table_convert_Base_Class
+
+
 #define REGIST_GLOBALFUNCTION_IMPLEMENT( _fun_type, _function, _fun_name_lua ) \
     XS::SGlobalExe _fun_name_lua##_register( ( XS::CreateGlobalFunWrap( \
 		(_fun_type)(&_function), NULL, #_fun_name_lua ), true ) ); 
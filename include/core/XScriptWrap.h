@@ -7,6 +7,7 @@
 
 #pragma once
 #include <array>
+#include <type_traits>
 #include "core/CScriptBase.h"
 
 namespace XS
@@ -82,6 +83,7 @@ namespace XS
 		eConstructType_Normal,
 		eConstructType_Unduplicatable,
 		eConstructType_Abstract,
+		eConstructType_Pod,
 	};
 
 	///< Get original virtual table
@@ -135,6 +137,9 @@ namespace XS
 		typename ConstructParamsType, EConstructType eType>
 	class TConstruct : public IObjectConstruct
 	{
+		static_assert( eType != eConstructType_Pod || std::is_trivially_copyable<OrgClass>::value,
+			"Pod class must be trivially copyable" );
+
 		template<typename... RemainParam> struct TFetchParam {};
 		template<> struct TFetchParam<>
 		{
@@ -180,12 +185,12 @@ namespace XS
 	public:
 		virtual void Assign( void* pDest, void* pSrc )
 		{
-			TCopy<ClassType, eType == eConstructType_Normal>( pDest, pSrc );
+			TCopy<ClassType, eType == eConstructType_Normal || eType == eConstructType_Pod>( pDest, pSrc );
 		}
 
 		virtual void CopyConstruct( void* pDest, void* pSrc )
 		{
-			TCopyConstruct<ClassType, eType == eConstructType_Normal>( pDest, pSrc );
+			TCopyConstruct<ClassType, eType == eConstructType_Normal || eType == eConstructType_Pod>( pDest, pSrc );
 		}
 
 		virtual void Construct( void* pObj, void** aryArg )
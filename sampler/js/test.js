@@ -6,9 +6,13 @@
         console.log(szMessage, " ........ ", (bResult ? "OK" : "Failed"));
     }
 
-    var CApplicationHandler = function () 
+    // C++类的方法带有接收者签名，派生类必须通过super()构造
+    class CApplicationHandler extends IApplicationHandler
     {
-        IApplicationHandler.call(this);
+        constructor() 
+        {
+            super();
+        }
     }
 
     window.XScript.class(CApplicationHandler, null, IApplicationHandler);
@@ -85,6 +89,14 @@
             12345678, 1234567891011, 123456789, 1234567, 123456789101112, "abcdefg", "abcdefg") == "OK",
             "Test return string");
         Test(g_App.TestNoParamFunction() == "OK", "Test function without parameter");
+
+        var shared = [1, 2, 3];
+        var src = { n: 1.5, s: "abc", list: shared, same: shared, map: { x: -1234567891011 } };
+        src.self = src;
+        var dst = XScript.deserialize(XScript.serialize(src));
+        Test(dst.n == 1.5 && dst.s == "abc" && dst.list.length == 3 && dst.list[2] == 3 &&
+            dst.map.x == -1234567891011, "Test serialize round trip");
+        Test(dst.list === dst.same && dst.self === dst, "Test serialize shared object");
     }
 
     console.log("Test javascript loaded");
@@ -69,6 +69,16 @@ function StartApplication( name, id )
 		12345678, 1234567891011, 123456789, 1234567, 123456789101112, "abcdefg", "abcdefg") == "OK",
 		"Test return string" );
 	Test( g_App:TestNoParamFunction() == "OK", "Test function without parameter" );
+
+	local shared = { 1, 2, 3 };
+	local src = { n = 1.5, s = "abc", list = shared, same = shared, map = { x = -1234567891011 } };
+	src.self = src;
+	local stream = Serialize( src );
+	stream:SetPosition( 0 );
+	local dst = Deserialize( stream );
+	Test( dst.n == 1.5 and dst.s == "abc" and #dst.list == 3 and dst.list[3] == 3 and
+		dst.map.x == -1234567891011, "Test serialize round trip" );
+	Test( dst.list == dst.same and dst.self == dst, "Test serialize shared table" );
 end
 
 print( "Test lua loaded" );
@@ -5,7 +5,9 @@
 #include <process.h>
 #else
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 using namespace XS;
@@ -117,6 +119,69 @@ namespace XS
 #else
 		int32 nFlag = MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS;
 		return mmap( pAddress, nSize, PROT_NONE, nFlag, -1, 0 ) == pAddress;
+#endif // _WIN32
+	}
+
+	void* MapFileToMemory( const char* szFileName, size_t& nSize )
+	{
+		nSize = 0;
+#ifdef _WIN32
+		HANDLE hFile = CreateFileA( szFileName, GENERIC_READ, FILE_SHARE_READ, 
+			NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+		if( hFile == INVALID_HANDLE_VALUE )
+			return NULL;
+
+		LARGE_INTEGER nFileSize;
+		if( !GetFileSizeEx( hFile, &nFileSize ) || nFileSize.QuadPart == 0 )
+		{
+			CloseHandle( hFile );
+			return NULL;
+		}
+
+		HANDLE hMapping = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+		CloseHandle( hFile );
+		if( hMapping == NULL )
+			return NULL;
+
+		///< The view keeps the mapping object alive
+		void* pAddress = MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+		CloseHandle( hMapping );
+		if( pAddress == NULL )
+			return NULL;
+		nSize = (size_t)nFileSize.QuadPart;
+		return pAddress;
+#else
+		int32 nFile = open( szFileName, O_RDONLY );
+		if( nFile < 0 )
+			return NULL;
+
+		struct stat FileStat;
+		if( fstat( nFile, &FileStat ) != 0 || 
+			!S_ISREG( FileStat.st_mode ) || FileStat.st_size == 0 )
+		{
+			close( nFile );
+			return NULL;
+		}
+
+		///< The mapping keeps the file alive
+		void* pAddress = mmap( NULL, (size_t)FileStat.st_size, 
+			PROT_READ, MAP_PRIVATE, nFile, 0 );
+		close( nFile );
+		if( pAddress == MAP_FAILED )
+			return NULL;
+		nSize = (size_t)FileStat.st_size;
+		return pAddress;
+#endif // _WIN32
+	}
+
+	bool UnmapFileFromMemory( void* pAddress, size_t nSize )
+	{
+		if( pAddress == NULL )
+			return false;
+#ifdef _WIN32
+		return UnmapViewOfFile( pAddress ) != 0;
+#else
+		return munmap( pAddress, nSize ) == 0;
 #endif // _WIN32
 	}
 }
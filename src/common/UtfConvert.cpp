@@ -0,0 +1,206 @@
+﻿#include "common/UtfConvert.h"
+#include <string.h>
+
+namespace XS
+{
+	#define UTF_REPLACEMENT_CHAR	0xFFFD
+	#define ASCII_MASK_64			0x8080808080808080ULL
+
+	//=====================================================================
+	// 内部实现，按宽字符的大小区分utf16与ucs4
+	//=====================================================================
+	inline bool IsHighSurrogate( uint32 c ) { return c >= 0xD800 && c <= 0xDBFF; }
+	inline bool IsLowSurrogate( uint32 c ) { return c >= 0xDC00 && c <= 0xDFFF; }
+
+	template<typename WideType>
+	inline WideType* WriteWideChar( WideType* pDes, uint32 c )
+	{
+		if( sizeof( WideType ) == 2 && c >= 0x10000 )
+		{
+			c -= 0x10000;
+			*pDes++ = (WideType)( 0xD800|( c >> 10 ) );
+			*pDes++ = (WideType)( 0xDC00|( c&0x3FF ) );
+			return pDes;
+		}
+		*pDes++ = (WideType)c;
+		return pDes;
+	}
+
+	template<typename WideType>
+	inline const WideType* ReadWideChar( const WideType* pSrc, const WideType* pEnd, uint32& c )
+	{
+		c = (uint32)*pSrc++;
+		if( IsHighSurrogate( c ) && pSrc < pEnd && IsLowSurrogate( (uint32)*pSrc ) )
+			c = 0x10000 + ( ( c - 0xD800 ) << 10 ) + ( (uint32)*pSrc++ - 0xDC00 );
+		else if( IsHighSurrogate( c ) || IsLowSurrogate( c ) || c > 0x10FFFF )
+			c = UTF_REPLACEMENT_CHAR;
+		return pSrc;
+	}
+
+	template<typename WideType>
+	size_t Utf8ToWide( WideType* szDes, const char* szSrc, size_t nLen )
+	{
+		const uint8* pSrc = (const uint8*)szSrc;
+		const uint8* pEnd = pSrc + nLen;
+		WideType* pDes = szDes;
+		while( pSrc < pEnd )
+		{
+			// ASCII快速通道，一次检查8个字节
+			while( pSrc + 8 <= pEnd )
+			{
+				uint64 nWord;
+				memcpy( &nWord, pSrc, sizeof( nWord ) );
+				if( nWord & ASCII_MASK_64 )
+					break;
+				for( uint32 i = 0; i < 8; i++ )
+					pDes[i] = (WideType)pSrc[i];
+				pDes += 8;
+				pSrc += 8;
+			}
+
+			if( pSrc >= pEnd )
+				break;
+
+			uint32 c = *pSrc;
+			if( c < 0x80 )
+			{
+				*pDes++ = (WideType)c;
+				pSrc++;
+				continue;
+			}
+
+			uint32 nExtra = 0;
+			uint32 nMin = 0;
+			if( ( c&0xE0 ) == 0xC0 )
+				nExtra = 1, nMin = 0x80, c &= 0x1F;
+			else if( ( c&0xF0 ) == 0xE0 )
+				nExtra = 2, nMin = 0x800, c &= 0x0F;
+			else if( ( c&0xF8 ) == 0xF0 )
+				nExtra = 3, nMin = 0x10000, c &= 0x07;
+
+			uint32 nRead = 1;
+			while( nExtra && nRead <= nExtra && pSrc + nRead < pEnd && 
+				( pSrc[nRead]&0xC0 ) == 0x80 )
+				c = ( c << 6 )|( pSrc[nRead++]&0x3F );
+
+			// 非法序列只跳过首字节，替换为U+FFFD
+			if( !nExtra || nRead != nExtra + 1 || c < nMin || 
+				c > 0x10FFFF || IsHighSurrogate( c ) || IsLowSurrogate( c ) )
+			{
+				*pDes++ = (WideType)UTF_REPLACEMENT_CHAR;
+				pSrc++;
+				continue;
+			}
+
+			pDes = WriteWideChar( pDes, c );
+			pSrc += nRead;
+		}
+		*pDes = 0;
+		return (size_t)( pDes - szDes );
+	}
+
+	template<typename WideType>
+	size_t WideToUtf8( char* szDes, const WideType* szSrc, size_t nLen )
+	{
+		const WideType* pSrc = szSrc;
+		const WideType* pEnd = pSrc + nLen;
+		uint8* pDes = (uint8*)szDes;
+		while( pSrc < pEnd )
+		{
+			// ASCII快速通道，一次检查4个字符
+			while( pSrc + 4 <= pEnd && 
+				( (uint32)pSrc[0]|(uint32)pSrc[1]|(uint32)pSrc[2]|(uint32)pSrc[3] ) < 0x80 )
+			{
+				pDes[0] = (uint8)pSrc[0];
+				pDes[1] = (uint8)pSrc[1];
+				pDes[2] = (uint8)pSrc[2];
+				pDes[3] = (uint8)pSrc[3];
+				pDes += 4;
+				pSrc += 4;
+			}
+
+			if( pSrc >= pEnd )
+				break;
+
+			uint32 c;
+			pSrc = ReadWideChar( pSrc, pEnd, c );
+			if( c < 0x80 )
+			{
+				*pDes++ = (uint8)c;
+			}
+			else if( c < 0x800 )
+			{
+				*pDes++ = (uint8)( 0xC0|( c >> 6 ) );
+				*pDes++ = (uint8)( 0x80|( c&0x3F ) );
+			}
+			else if( c < 0x10000 )
+			{
+				*pDes++ = (uint8)( 0xE0|( c >> 12 ) );
+				*pDes++ = (uint8)( 0x80|( ( c >> 6 )&0x3F ) );
+				*pDes++ = (uint8)( 0x80|( c&0x3F ) );
+			}
+			else
+			{
+				*pDes++ = (uint8)( 0xF0|( c >> 18 ) );
+				*pDes++ = (uint8)( 0x80|( ( c >> 12 )&0x3F ) );
+				*pDes++ = (uint8)( 0x80|( ( c >> 6 )&0x3F ) );
+				*pDes++ = (uint8)( 0x80|( c&0x3F ) );
+			}
+		}
+		*pDes = 0;
+		return (size_t)( pDes - (uint8*)szDes );
+	}
+
+	template<typename DesType, typename SrcType>
+	size_t WideToWide( DesType* szDes, const SrcType* szSrc, size_t nLen )
+	{
+		const SrcType* pSrc = szSrc;
+		const SrcType* pEnd = pSrc + nLen;
+		DesType* pDes = szDes;
+		if( sizeof( DesType ) == sizeof( SrcType ) )
+		{
+			memmove( szDes, szSrc, nLen*sizeof( SrcType ) );
+			pDes += nLen;
+		}
+		else
+		{
+			// 先读后写，szSrc位于szDes尾部时也可以原地转换
+			while( pSrc < pEnd )
+			{
+				uint32 c;
+				pSrc = ReadWideChar( pSrc, pEnd, c );
+				pDes = WriteWideChar( pDes, c );
+			}
+		}
+		*pDes = 0;
+		return (size_t)( pDes - szDes );
+	}
+
+	//=====================================================================
+	// 对外接口
+	//=====================================================================
+	size_t Utf8ToUcs( wchar_t* szDes, const char* szSrc, size_t nLen )
+	{
+		return Utf8ToWide( szDes, szSrc, nLen );
+	}
+
+	size_t UcsToUtf8( char* szDes, const wchar_t* szSrc, size_t nLen )
+	{
+		return WideToUtf8( szDes, szSrc, nLen );
+	}
+
+	size_t Utf16ToUtf8( char* szDes, const uint16* szSrc, size_t nLen )
+	{
+		return WideToUtf8( szDes, szSrc, nLen );
+	}
+
+	size_t Utf16ToUcs( wchar_t* szDes, const uint16* szSrc, size_t nLen )
+	{
+		return WideToWide( szDes, szSrc, nLen );
+	}
+
+	size_t UcsToUtf16( uint16* szDes, const wchar_t* szSrc, size_t nLen )
+	{
+		return WideToWide( szDes, szSrc, nLen );
+	}
+}
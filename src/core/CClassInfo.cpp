@@ -1,6 +1,8 @@
 ﻿#include "core/CCallInfo.h"
 #include "core/CScriptBase.h"
 #include "core/CClassInfo.h"
+#include <cstring>
+#include <set>
 
 namespace XS
 {
@@ -65,7 +67,7 @@ namespace XS
 	}
 
 	const CClassInfo* CClassInfo::SetObjectConstruct( 
-		const char* szTypeInfoName, IObjectConstruct* pObjectConstruct )
+		const char* szTypeInfoName, IObjectConstruct* pObjectConstruct, bool bPod )
 	{
 		const_string strKey( szTypeInfoName, true );
 		CGlobalClassRegist& Inst = CGlobalClassRegist::GetInst();
@@ -73,6 +75,7 @@ namespace XS
 		CClassInfo* pInfo = Inst.m_mapTypeID2ClassInfo.Find( strKey );
 		pInfo->m_vecParamType.clear();
 		pInfo->m_pObjectConstruct = pObjectConstruct;
+		pInfo->m_bIsPod = bPod;
 
 		if( !pObjectConstruct )
 			return pInfo;
@@ -82,6 +85,16 @@ namespace XS
 		return pInfo;
 	}
 
+	const CClassInfo* CClassInfo::EnableTableConvert( const char* szTypeInfoName )
+	{
+		const_string strKey( szTypeInfoName, true );
+		CGlobalClassRegist& Inst = CGlobalClassRegist::GetInst();
+		CClassInfo* pInfo = Inst.m_mapTypeID2ClassInfo.Find( strKey );
+		assert( pInfo && !pInfo->IsEnum() );
+		pInfo->m_bTableConvert = true;
+		return pInfo;
+	}
+
 	const CClassInfo* CClassInfo::AddBaseInfo( 
 		const char* szTypeInfoName, const char* szBaseTypeInfoName, ptrdiff_t nOffset )
 	{
@@ -167,6 +180,9 @@ namespace XS
 		, m_nAligenSizeOfClass( 0 )
         , m_pObjectConstruct( NULL )
         , m_bIsEnum(false)
+		, m_bIsPod(false)
+		, m_bTableConvert(false)
+		, m_nFieldBufferSize(0)
 		, m_nInheritDepth(0)
 	{
     }
@@ -177,6 +193,55 @@ namespace XS
 			delete m_mapRegistFunction.GetFirst();
     }
 
+	static void CollectFields( const CClassInfo* pInfo, int32 nBaseOff,
+		CClassInfo::CFieldArray& vecField, std::set<const_string>& setName )
+	{
+		const CCallBaseMap& mapFunction = pInfo->GetRegistFunction();
+		for( auto pCall = mapFunction.GetFirst(); pCall; pCall = pCall->GetNext() )
+		{
+			if( pCall->GetFunctionIndex() != eCT_MemberFunction ||
+				!setName.insert( pCall->GetFunctionName() ).second )
+				continue;
+			CClassInfo::SFieldInfo Field = { static_cast<const CMemberInfo*>( pCall ), nBaseOff };
+			vecField.push_back( Field );
+		}
+
+		for( size_t i = 0; i < pInfo->BaseRegist().size(); i++ )
+		{
+			auto& BaseInfo = pInfo->BaseRegist()[i];
+			CollectFields( BaseInfo.m_pBaseInfo, nBaseOff + BaseInfo.m_nBaseOff, vecField, setName );
+		}
+	}
+
+	const CClassInfo::CFieldArray& CClassInfo::GetFields() const
+	{
+		// 注册在静态初始化时完成，第一次使用时再收集，避免依赖注册顺序
+		std::call_once( m_FieldOnce, [this]()
+		{
+			std::set<const_string> setName;
+			CollectFields( this, 0, m_vecField, setName );
+			size_t nMaxSize = sizeof( int64 );
+			for( size_t i = 0; i < m_vecField.size(); i++ )
+				nMaxSize = std::max( nMaxSize, GetAligenSizeOfType( m_vecField[i].m_pMember->GetResultType() ) );
+			m_nFieldBufferSize = nMaxSize;
+		} );
+		return m_vecField;
+	}
+
+	size_t CClassInfo::GetFieldBufferSize() const
+	{
+		GetFields();
+		return m_nFieldBufferSize;
+	}
+
+	const CClassInfo* CClassInfo::GetConvertibleClass( DataType nType )
+	{
+		if( !IsValueClass( nType ) )
+			return NULL;
+		auto pClassInfo = (const CClassInfo*)( ( nType >> 1 ) << 1 );
+		return pClassInfo->IsTableConvert() ? pClassInfo : NULL;
+	}
+
     void CClassInfo::InitVirtualTable( SFunctionTable* pNewTable ) const
 	{
 		for( int32 i = 0; i < (int32)m_vecOverridableFun.size(); i++ )
@@ -211,7 +276,10 @@ namespace XS
 		assert( m_pObjectConstruct );
 		if( !m_pObjectConstruct )
 			return;
-		m_pObjectConstruct->CopyConstruct( pDest, pSrc );
+		if( m_bIsPod )
+			memcpy( pDest, pSrc, m_nSizeOfClass );
+		else
+			m_pObjectConstruct->CopyConstruct( pDest, pSrc );
 	}
 
     void CClassInfo::Destruct( CScriptBase* pScript, void* pObject ) const
@@ -219,7 +287,7 @@ namespace XS
 		pScript->CheckDebugCmd();
 		//声明性质的类不可销毁
 		assert( m_pObjectConstruct );
-		if( !m_pObjectConstruct )
+		if( !m_pObjectConstruct || m_bIsPod )
 			return;
 		m_pObjectConstruct->Destruct( pObject );
 	}
@@ -230,7 +298,10 @@ namespace XS
 		assert( m_pObjectConstruct );
 		if( !m_pObjectConstruct )
 			return;
-		m_pObjectConstruct->Assign( pDest, pSrc );
+		if( m_bIsPod )
+			memcpy( pDest, pSrc, m_nSizeOfClass );
+		else
+			m_pObjectConstruct->Assign( pDest, pSrc );
 	}
 
 	const CCallInfo* CClassInfo::GetCallBase( const const_string& strFunName ) const
@@ -76,6 +76,7 @@ namespace XS
 		: m_pBase( pBase )
 		, m_nRemoteListener( INVALID_SOCKET )
 		, m_nRemoteConnecter( INVALID_SOCKET )
+		, m_nDebugPort( nDebugPort )
 		, m_bAllExceptionsBreak( false )
 		, m_bUncaughtExceptionsBreak( false )
 		, m_bPrintFrame( true )
@@ -103,6 +104,31 @@ namespace XS
 			closesocket( m_nRemoteConnecter );
 	}
 
+	bool CDebugBase::StopRemote()
+	{
+		if( m_nRemoteConnecter != INVALID_SOCKET )
+			return false;
+		intptr_t nListener = m_nRemoteListener.exchange( INVALID_SOCKET );
+		if( nListener == INVALID_SOCKET )
+			return true;
+
+		// shutdown会唤醒阻塞在accept上的线程
+		shutdown( nListener, 2 );
+		closesocket( nListener );
+		if( m_hThread.joinable() )
+			m_hThread.join();
+		return true;
+	}
+
+	void CDebugBase::RestartRemote( uint16 nDebugPort )
+	{
+		if( m_nRemoteListener != INVALID_SOCKET || m_hThread.joinable() )
+			return;
+		m_nDebugPort = nDebugPort;
+		if( nDebugPort )
+			ListenRemote( nDebugPort );
+	}
+
 	bool CDebugBase::RemoteDebugEnable() const
 	{
 		return m_nRemoteListener != INVALID_SOCKET;
@@ -176,6 +202,11 @@ namespace XS
 		vecLines.push_back( std::string( pStart, pCur - pStart ) );
 	}
 
+	void CDebugBase::RemoveFileContent( const char* szSource )
+	{
+		m_mapFileBuffer.erase( szSource );
+	}
+
 	const char* CDebugBase::ReadFileLine( const char* szSource, int32 nLine )
 	{
 		CFileMap::iterator it = m_mapFileBuffer.find( szSource );
@@ -258,7 +289,10 @@ namespace XS
 		{
 			sockaddr_in Address;
 			socklen_t nSize = sizeof( sockaddr_in );
-			m_nRemoteConnecter = accept( m_nRemoteListener, (sockaddr*)&Address, &nSize );
+			intptr_t nListener = m_nRemoteListener;
+			if( nListener == INVALID_SOCKET )
+				return;
+			m_nRemoteConnecter = accept( nListener, (sockaddr*)&Address, &nSize );
 			if( m_nRemoteConnecter == INVALID_SOCKET )
 				continue;
 			m_eAttachType = eAT_Waiting;
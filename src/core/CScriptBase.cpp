@@ -1,9 +1,12 @@
 ﻿#include <sstream>
+#include <sys/stat.h>
 #include "common/Help.h"
 #include "common/Memory.h"
 #include "core/CScriptBase.h"
 #include "core/CCallInfo.h"
 #include "core/CDebugBase.h"
+#include "core/CScriptPackage.h"
+#include "core/CScriptOutput.h"
 
 namespace XS
 {
@@ -18,6 +21,8 @@ namespace XS
 	{
 		uint32					m_nCacheSize;
 		char*					m_pFile;
+		void*					m_pMapAddress;
+		size_t					m_nMapSize;
 	};
 
 	enum{ eFunctionTableHeadSize = sizeof(SFunctionTableHead)  };
@@ -38,20 +43,22 @@ namespace XS
 	static void** s_aryFuctionTable = (void**)ReserveMemoryPage( NULL, RESERVED_SIZE );
 	static void** s_aryFuctionTableEnd = s_aryFuctionTable;
 
+	static std::mutex s_FunctionTableLock;
+	static uint32 s_nForkPrepareCount = 0;
+
 	static SFunctionTableHead* AllocFunArray( size_t nArraySize )
 	{
-		static std::mutex s_Lock;
 		static uint32 s_nFuctionTableUseCount = 0;
 		static uint32 s_nFuctionTableCommitCount = 0;
 
-		s_Lock.lock();
+		s_FunctionTableLock.lock();
 		nArraySize += ePointerCount;
 		uint32 nUseCount = s_nFuctionTableUseCount + (uint32)nArraySize;
 		if( nUseCount > s_nFuctionTableCommitCount )
 		{
 			if( nUseCount > MAX_VIRTUAL_FUN_COUNT )
 			{
-				s_Lock.unlock();
+				s_FunctionTableLock.unlock();
 				throw( "No enough buffer for funtion table!!!!" );
 			}
 
@@ -70,7 +77,7 @@ namespace XS
 
 		void** aryFun = s_aryFuctionTable + s_nFuctionTableUseCount;
 		s_nFuctionTableUseCount += (uint32)nArraySize;
-		s_Lock.unlock();
+		s_FunctionTableLock.unlock();
 		return (SFunctionTableHead*)aryFun;
 	}
 
@@ -84,12 +91,27 @@ namespace XS
 	//==================================================================
     CScriptBase::CScriptBase(void)
         : m_pDebugger( NULL )
+		, m_nStringCacheSize( 256 )
+		, m_nStringChunkID( 0 )
+		, m_nStringCacheHit( 0 )
+		, m_nStringCacheMiss( 0 )
+		, m_pOutput( NULL )
+		, m_nExecBudget( 0 )
+		, m_nExecDepth( 0 )
+		, m_bBudgetArmed( false )
+		, m_bBudgetExceeded( false )
+		, m_pForkOutputSink( NULL )
+		, m_nForkOutputSize( 0 )
+		, m_bForkPrepared( false )
 	{
     }
 
     CScriptBase::~CScriptBase(void)
 	{
 		SAFE_DELETE( m_pDebugger );
+		SAFE_DELETE( m_pOutput );
+		for( auto it = m_mapSearchPackage.begin(); it != m_mapSearchPackage.end(); ++it )
+			delete it->second;
 
 		// 虚表不释放，这里的内存泄漏是故意的
 		for( CFunctionTableMap::iterator it = m_mapVirtualTableOld2New.begin(); 
@@ -153,10 +175,10 @@ namespace XS
 		return pClassInfo != nullptr;
 	}
 
-	bool CScriptBase::RegisterConstruct( IObjectConstruct* pObjectConstruct, const char* szTypeIDName )
+	bool CScriptBase::RegisterConstruct( IObjectConstruct* pObjectConstruct, const char* szTypeIDName, bool bPod )
 	{
 		assert( CClassInfo::GetClassInfo( szTypeIDName ) );
-		CClassInfo::SetObjectConstruct( szTypeIDName, pObjectConstruct );
+		CClassInfo::SetObjectConstruct( szTypeIDName, pObjectConstruct, bPod );
 		return true;
 	}
 
@@ -172,6 +194,11 @@ namespace XS
 		return CClassInfo::RegisterClass( szEnumName, szTypeIDName, nTypeSize, true ) != nullptr;
 	}
 
+	bool CScriptBase::RegisterTableConvert( const char* szTypeIDName )
+	{
+		return CClassInfo::EnableTableConvert( szTypeIDName ) != nullptr;
+	}
+
 	void CScriptBase::CheckDebugCmd()
 	{
 		if( !m_pDebugger || !m_pDebugger->RemoteCmdValid() )
@@ -280,6 +307,51 @@ namespace XS
 		strPath.push_back( '/' );
 	}
 
+	bool CScriptBase::AddSearchPackage( const char* szPackage )
+	{
+		CScriptPackage* pPackage = new CScriptPackage;
+		if( !pPackage->Open( szPackage ) )
+		{
+			delete pPackage;
+			return false;
+		}
+
+		// 包作为一个目录挂到搜索路径上，包内的文件在OpenFile中查找
+		AddSearchPath( szPackage );
+		std::string& strPath = *m_listSearchPath.rbegin();
+		strPath.resize( ShortPath( &strPath[0] ) );
+		CScriptPackage*& pPrePackage = m_mapSearchPackage[strPath];
+		if( pPrePackage )
+			m_listSearchPath.pop_back();
+		delete pPrePackage;
+		pPrePackage = pPackage;
+		ClearPathCache( NULL );
+		return true;
+	}
+
+	bool CScriptBase::PublishSharedData( const char*, const CSharedData* )
+	{
+		return false;
+	}
+
+	bool CScriptBase::SerializeGlobal( const char*, std::string& )
+	{
+		return false;
+	}
+
+	bool CScriptBase::DeserializeGlobal( const char*, const void*, size_t )
+	{
+		return false;
+	}
+
+	void CScriptBase::ClearPathCache( const char* szFileName )
+	{
+		if( szFileName )
+			m_mapResolvedPath.erase( szFileName );
+		else
+			m_mapResolvedPath.clear();
+	}
+
 	int CScriptBase::Input( char* szBuffer, int nCount )
 	{
 		for( int32 i = 0; i < nCount - 1; i++ )
@@ -295,10 +367,81 @@ namespace XS
 
 	int CScriptBase::Output( const char* szBuffer, int nCount )
 	{
+		if( m_pOutput )
+		{
+			size_t nSize = nCount < 0 ? strlen( szBuffer ) : (size_t)nCount;
+			m_pOutput->Write( szBuffer, (uint32)nSize );
+			return nCount;
+		}
 		std::cout << szBuffer;
 		return nCount;
 	}
 
+	void CScriptBase::EnableAsyncOutput( IScriptOutputSink* pSink, uint32 nMaxBufferSize )
+	{
+		DisableAsyncOutput();
+		std::cout.flush();
+		m_pOutput = new CScriptOutput( pSink, nMaxBufferSize );
+	}
+
+	void CScriptBase::DisableAsyncOutput()
+	{
+		// 析构时会写完剩下的输出
+		SAFE_DELETE( m_pOutput );
+	}
+
+	//==================================================================
+	// fork
+	//==================================================================
+	bool CScriptBase::PrepareFork()
+	{
+		if( m_bForkPrepared || m_nExecDepth )
+			return false;
+		if( m_pDebugger && !m_pDebugger->StopRemote() )
+			return false;
+
+		if( m_pOutput )
+		{
+			m_pForkOutputSink = m_pOutput->GetSink();
+			m_nForkOutputSize = m_pOutput->GetMaxBufferSize();
+			DisableAsyncOutput();
+		}
+
+		// 虚表分配可能在其他线程进行，fork期间持有锁，子进程的锁状态才是确定的
+		// 多个虚拟机共用一个锁，由调用fork的线程计数
+		if( s_nForkPrepareCount++ == 0 )
+			s_FunctionTableLock.lock();
+		m_bForkPrepared = true;
+		return true;
+	}
+
+	void CScriptBase::AfterFork( bool bChild, uint16 nDebugPort )
+	{
+		if( !m_bForkPrepared )
+			return;
+		m_bForkPrepared = false;
+		if( --s_nForkPrepareCount == 0 )
+			s_FunctionTableLock.unlock();
+
+		if( m_pForkOutputSink )
+			EnableAsyncOutput( m_pForkOutputSink, m_nForkOutputSize );
+		m_pForkOutputSink = NULL;
+
+		if( m_pDebugger )
+			m_pDebugger->RestartRemote( bChild ? nDebugPort : m_pDebugger->GetDebugPort() );
+	}
+
+	void CScriptBase::FlushOutput()
+	{
+		if( m_pOutput )
+			m_pOutput->Flush();
+	}
+
+	uint64 CScriptBase::GetOutputDropSize() const
+	{
+		return m_pOutput ? m_pOutput->GetDropSize() : 0;
+	}
+
 	void* CScriptBase::OpenFile( const char* szFileName )
 	{
 		size_t nNameLen = strlen( szFileName );
@@ -306,22 +449,63 @@ namespace XS
 		if( nNameLen > s_CacheTruckPrefix.size() &&
 			!memcmp( szFileName, s_CacheTruckPrefix.c_str(), nKeyLen ) )
 		{
-			uintptr_t address = 0;
-			std::stringstream( szFileName + nKeyLen ) >> address;
-			if( !address )
+			uint32 nChunkID = 0;
+			std::stringstream( szFileName + nKeyLen ) >> nChunkID;
+			auto itChunk = m_mapRuningChunk.find( nChunkID );
+			if( itChunk == m_mapRuningChunk.end() )
 				return nullptr;
+			const const_string& strContent = itChunk->second->m_strContent;
 			SFileContext* pContext = new SFileContext;
-			pContext->m_nCacheSize = (uint32)strlen( (const char*)address );
-			pContext->m_pFile = (char*)address;
+			pContext->m_nCacheSize = (uint32)strContent.size();
+			pContext->m_pFile = (char*)strContent.c_str();
+			pContext->m_pMapAddress = nullptr;
+			pContext->m_nMapSize = 0;
+			m_setFileContext.insert( pContext );
 			return pContext;
 		}
 
+		for( auto it = m_mapSearchPackage.begin(); it != m_mapSearchPackage.end(); ++it )
+		{
+			const std::string& strPath = it->first;
+			if( nNameLen <= strPath.size() ||
+				memcmp( szFileName, strPath.c_str(), strPath.size() ) )
+				continue;
+			uint32 nSize = 0;
+			const char* pFile = it->second->Find( szFileName + strPath.size(), nSize );
+			if( !pFile )
+				return nullptr;
+			SFileContext* pContext = new SFileContext;
+			pContext->m_nCacheSize = nSize;
+			pContext->m_pFile = (char*)pFile;
+			pContext->m_pMapAddress = nullptr;
+			pContext->m_nMapSize = 0;
+			m_setFileContext.insert( pContext );
+			return pContext;
+		}
+
+		size_t nMapSize = 0;
+		void* pMapAddress = MapFileToMemory( szFileName, nMapSize );
+		if( pMapAddress && nMapSize < INVALID_32BITID )
+		{
+			SFileContext* pContext = new SFileContext;
+			pContext->m_nCacheSize = (uint32)nMapSize;
+			pContext->m_pFile = (char*)pMapAddress;
+			pContext->m_pMapAddress = pMapAddress;
+			pContext->m_nMapSize = nMapSize;
+			m_setFileContext.insert( pContext );
+			return pContext;
+		}
+		UnmapFileFromMemory( pMapAddress, nMapSize );
+
 		FILE* fp = fopen( szFileName, "rb" );
 		if( nullptr == fp )
 			return nullptr;
 		SFileContext* pContext = new SFileContext;
 		pContext->m_nCacheSize = INVALID_32BITID;
 		pContext->m_pFile = (char*)fp;
+		pContext->m_pMapAddress = nullptr;
+		pContext->m_nMapSize = 0;
+		m_setFileContext.insert( pContext );
 		return pContext;
 	}
 
@@ -346,10 +530,59 @@ namespace XS
 	{
 		if (!pContext)
 			return;
+		m_setFileContext.erase( pContext );
 		SFileContext* pFileContext = (SFileContext*)pContext;
 		if (pFileContext->m_nCacheSize == INVALID_32BITID)
 			fclose((FILE*)(pFileContext->m_pFile));
-		delete pContext;
+		else if( pFileContext->m_pMapAddress )
+			UnmapFileFromMemory( pFileContext->m_pMapAddress, pFileContext->m_nMapSize );
+		delete pFileContext;
+	}
+
+	const char* CScriptBase::GetFileBuffer( void* pContext, size_t& nSize )
+	{
+		nSize = 0;
+		// 派生类重载OpenFile后，打开的文件不是SFileContext
+		if( !pContext || !m_setFileContext.count( pContext ) )
+			return nullptr;
+		SFileContext* pFileContext = (SFileContext*)pContext;
+		if( pFileContext->m_nCacheSize == INVALID_32BITID )
+			return nullptr;
+		nSize = pFileContext->m_nCacheSize;
+		return pFileContext->m_pFile;
+	}
+
+	bool CScriptBase::RunScriptFile( const char* szFileName, bool& bFileExist )
+	{
+		bFileExist = false;
+		void* pContext = OpenFile( szFileName );
+		if( !pContext )
+			return false;
+
+		// 映射到内存的文件直接交给虚拟机，不需要拷贝
+		size_t nSize = 0;
+		std::string strFileContent;
+		const char* pBuffer = GetFileBuffer( pContext, nSize );
+		if( !pBuffer )
+		{
+			char szBuffer[1024];
+			int32 nReadSize = 0;
+			while( ( nReadSize = ReadFile( pContext, szBuffer, 1024 ) ) > 0 )
+				strFileContent.append( szBuffer, nReadSize );
+			pBuffer = strFileContent.c_str();
+			nSize = strFileContent.size();
+		}
+
+		if( !nSize )
+		{
+			CloseFile( pContext );
+			return false;
+		}
+
+		bFileExist = true;
+		bool bResult = RunBuffer( pBuffer, nSize, szFileName );
+		CloseFile( pContext );
+		return bResult;
 	}
 
 	bool CScriptBase::RunFile( const char* szFileName )
@@ -357,53 +590,254 @@ namespace XS
 		CheckDebugCmd();
 		if( !szFileName )
 			return false;
+		CBudgetGuard Guard( this );
 
+		bool bFileExist = false;
 		if( szFileName[0] == '/' || ::strchr( szFileName, ':' ) )
 		{
-			std::string strFileContent = ReadEntirFile( szFileName );
-			if( strFileContent.empty() )
-				return false;
-			if( !RunBuffer( strFileContent.c_str(), strFileContent.size(), szFileName ) )
+			bool bResult = RunScriptFile( szFileName, bFileExist );
+			if( bFileExist )
+				RecordLoadedFile( szFileName, szFileName );
+			if( !bResult )
 				return false;
 			if( GetDebugger() && GetDebugger()->RemoteDebugEnable() )
 				GetDebugger()->AddFileContent( szFileName, "" );
 			return true;
 		}
 
+		// 先用上次找到的路径，文件不在了才重新搜索
+		auto itResolved = m_mapResolvedPath.find( szFileName );
+		if( itResolved != m_mapResolvedPath.end() )
+		{
+			// 脚本执行时可能清理或者修改路径缓存，路径要先复制出来
+			std::string strResolved = itResolved->second;
+			bool bResult = RunScriptFile( strResolved.c_str(), bFileExist );
+			if( bFileExist )
+				RecordLoadedFile( szFileName, strResolved.c_str() );
+			if( bResult )
+			{
+				if( GetDebugger() )
+					GetDebugger()->AddFileContent( strResolved.c_str(), "" );
+				return true;
+			}
+			if( bFileExist )
+				return false;
+			m_mapResolvedPath.erase( szFileName );
+		}
+
 		for( auto it = m_listSearchPath.begin(); it != m_listSearchPath.end(); ++it )
 		{
 			std::string sFileName = *it + szFileName;
-			ShortPath( &sFileName[0] );
-			std::string strFileContent = ReadEntirFile( sFileName.c_str() );
-			if( strFileContent.empty() )
-				continue;
-			if( !RunBuffer( strFileContent.c_str(), strFileContent.size(), sFileName.c_str() ) )
+			sFileName.resize( ShortPath( &sFileName[0] ) );
+			bool bResult = RunScriptFile( sFileName.c_str(), bFileExist );
+			if( bFileExist )
+			{
+				m_mapResolvedPath[szFileName] = sFileName;
+				RecordLoadedFile( szFileName, sFileName.c_str() );
+			}
+			if( bResult )
+			{
+				if( GetDebugger() )
+					GetDebugger()->AddFileContent( sFileName.c_str(), "" );
+				return true;
+			}
+			if( bFileExist )
 				return false;
-			if( GetDebugger() )
-				GetDebugger()->AddFileContent( sFileName.c_str(), "" );
-			return true;
 		}
 		return false;
 	}
 
+	static int64 GetFileModifyTime( const char* szPath, int64& nFileSize )
+	{
+		struct stat FileStat;
+		if( stat( szPath, &FileStat ) != 0 )
+			return 0;
+		nFileSize = (int64)FileStat.st_size;
+		return (int64)FileStat.st_mtime;
+	}
+
+	void CScriptBase::RecordLoadedFile( const char* szFileName, const char* szPath )
+	{
+		// 包内的文件没有修改时间，随包一起替换
+		int64 nFileSize = 0;
+		int64 nModifyTime = GetFileModifyTime( szPath, nFileSize );
+		if( !nModifyTime )
+			return;
+		SLoadedFile& LoadedFile = m_mapLoadedFile[szFileName];
+		LoadedFile.m_strPath = szPath;
+		LoadedFile.m_nModifyTime = nModifyTime;
+		LoadedFile.m_nFileSize = nFileSize;
+	}
+
+	void CScriptBase::BeginReload()
+	{
+	}
+
+	void CScriptBase::EndReload()
+	{
+	}
+
+	bool CScriptBase::ReloadFile( const char* szFileName )
+	{
+		return RunFile( szFileName );
+	}
+
+	uint32 CScriptBase::ReloadChangedFiles()
+	{
+		CheckDebugCmd();
+		std::vector<std::string> vecChanged;
+		for( auto it = m_mapLoadedFile.begin(); it != m_mapLoadedFile.end(); )
+		{
+			int64 nFileSize = 0;
+			int64 nModifyTime = GetFileModifyTime( it->second.m_strPath.c_str(), nFileSize );
+			if( !nModifyTime )
+			{
+				ClearPathCache( it->first.c_str() );
+				m_mapLoadedFile.erase( it++ );
+				continue;
+			}
+			// 修改时间只精确到秒，同一秒内的修改靠文件大小区分
+			if( nModifyTime != it->second.m_nModifyTime || 
+				nFileSize != it->second.m_nFileSize )
+				vecChanged.push_back( it->first );
+			++it;
+		}
+
+		if( vecChanged.empty() )
+			return 0;
+		BeginReload();
+		for( size_t i = 0; i < vecChanged.size(); i++ )
+			ReloadFile( vecChanged[i].c_str() );
+		EndReload();
+		return (uint32)vecChanged.size();
+	}
+
 	bool CScriptBase::RunString( const char* szString )
 	{
 		CheckDebugCmd();
+		CBudgetGuard Guard( this );
 
+		// 按内容查找，命中则直接复用已编译的代码块
 		const_string strKey( szString, true );
-		auto itPre = m_setRuningString.find( strKey );
-		if( itPre == m_setRuningString.end() )
-			itPre = m_setRuningString.insert( szString ).first;
-
-		std::stringstream name;
-		name << s_CacheTruckPrefix << (uintptr_t)(void*)( itPre->c_str() );
-		std::string strName = name.str();
-		const char* szName = strName.c_str();
-		if( !RunBuffer( itPre->c_str(), itPre->size(), szName ) )
-			return false;
-		if( GetDebugger() )
+		auto itFind = m_mapRuningString.find( strKey );
+		bool bNewString = itFind == m_mapRuningString.end();
+		if( bNewString )
+		{
+			m_nStringCacheMiss++;
+			SRunningString NewString = { const_string( szString ), ++m_nStringChunkID };
+			m_listRuningString.push_front( NewString );
+			auto itNew = m_listRuningString.begin();
+			m_mapRuningString[itNew->m_strContent] = itNew;
+			m_mapRuningChunk[itNew->m_nChunkID] = itNew;
+			ClipStringCache( m_nStringCacheSize );
+		}
+		else
+		{
+			m_nStringCacheHit++;
+			m_listRuningString.splice( m_listRuningString.begin(), 
+				m_listRuningString, itFind->second );
+		}
+
+		// 执行过程中可能嵌套调用RunString淘汰当前项，这里先取出需要的信息
+		const SRunningString& CurString = m_listRuningString.front();
+		const char* szContent = CurString.m_strContent.c_str();
+		size_t nSize = CurString.m_strContent.size();
+		char szName[64];
+		sprintf( szName, "%s%u", s_CacheTruckPrefix.c_str(), CurString.m_nChunkID );
+		if( bNewString && GetDebugger() )
 			GetDebugger()->AddFileContent( szName, szString );
-		return true;
+		return RunBuffer( szContent, nSize, szName );
+	}
+
+	void CScriptBase::EnterExecution()
+	{
+		// 只有最外层的调用计算预算，嵌套调用共用同一个期限
+		if( m_nExecDepth++ || !m_nExecBudget )
+			return;
+		m_bBudgetExceeded = false;
+		m_bBudgetArmed = true;
+		m_tBudgetDeadline = std::chrono::steady_clock::now() + 
+			std::chrono::milliseconds( m_nExecBudget );
+		BeginBudget();
+	}
+
+	void CScriptBase::LeaveExecution()
+	{
+		if( --m_nExecDepth || !m_bBudgetArmed )
+			return;
+		EndBudget();
+		m_bBudgetArmed = false;
+	}
+
+	bool CScriptBase::CheckBudget()
+	{
+		if( !m_bBudgetArmed )
+			return false;
+		if( !m_bBudgetExceeded && std::chrono::steady_clock::now() >= m_tBudgetDeadline )
+			m_bBudgetExceeded = true;
+		return m_bBudgetExceeded;
+	}
+
+	void CScriptBase::BeginBudget()
+	{
+	}
+
+	void CScriptBase::EndBudget()
+	{
+	}
+
+	void CScriptBase::SetStringCacheSize( uint32 nMaxCount )
+	{
+		// 至少保留一项，正在执行的代码块不能被淘汰
+		m_nStringCacheSize = nMaxCount ? nMaxCount : 1;
+		ClipStringCache( m_nStringCacheSize );
+	}
+
+	void CScriptBase::ClipStringCache( uint32 nMaxCount )
+	{
+		char szName[64];
+		while( m_listRuningString.size() > nMaxCount )
+		{
+			const SRunningString& LastString = m_listRuningString.back();
+			sprintf( szName, "%s%u", s_CacheTruckPrefix.c_str(), LastString.m_nChunkID );
+			ReleaseChunk( szName );
+			if( GetDebugger() )
+				GetDebugger()->RemoveFileContent( szName );
+			m_mapRuningString.erase( LastString.m_strContent );
+			m_mapRuningChunk.erase( LastString.m_nChunkID );
+			m_listRuningString.pop_back();
+		}
+	}
+
+	void CScriptBase::AddObjectStat( const CClassInfo* pInfo, EObjectStat eType, int32 nDelta )
+	{
+		auto it = m_mapObjectStat.find( pInfo );
+		if( it == m_mapObjectStat.end() )
+		{
+			SObjectStat NewStat = { { 0 }, 0 };
+			it = m_mapObjectStat.insert( std::make_pair( pInfo, NewStat ) ).first;
+		}
+		it->second.m_aryCount[eType] += nDelta;
+		if( eType != eObjStat_Bound )
+			it->second.m_nNativeBytes += (int64)nDelta*pInfo->GetClassSize();
+	}
+
+	SObjectStat CScriptBase::GetObjectStat( const CClassInfo* pInfo )
+	{
+		auto it = m_mapObjectStat.find( pInfo );
+		if( it != m_mapObjectStat.end() )
+			return it->second;
+		SObjectStat EmptyStat = { { 0 }, 0 };
+		return EmptyStat;
+	}
+
+	const CObjectStatMap& CScriptBase::GetAllObjectStat()
+	{
+		return m_mapObjectStat;
+	}
+
+	void CScriptBase::ReleaseChunk( const char* )
+	{
 	}
 
 	void CScriptBase::CallBack( int32 nIndex, void* pRetBuf, void** pArgArray )
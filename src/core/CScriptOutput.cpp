@@ -0,0 +1,87 @@
+﻿#include <stdio.h>
+#include "core/CScriptOutput.h"
+
+namespace XS
+{
+	class CStdOutputSink : public IScriptOutputSink
+	{
+	public:
+		virtual void Write( const char* szBuffer, uint32 nSize )
+		{
+			fwrite( szBuffer, 1, nSize, stdout );
+			fflush( stdout );
+		}
+
+		static CStdOutputSink& GetInst()
+		{
+			static CStdOutputSink s_Instance;
+			return s_Instance;
+		}
+	};
+
+	CScriptOutput::CScriptOutput( IScriptOutputSink* pSink, uint32 nMaxBufferSize )
+		: m_pSink( pSink ? pSink : &CStdOutputSink::GetInst() )
+		, m_nMaxBufferSize( nMaxBufferSize )
+		, m_nDropSize( 0 )
+		, m_bWriting( false )
+		, m_bQuit( false )
+	{
+		struct _{  static void Run( CScriptOutput* pThis ) { pThis->Run(); } };
+		m_hThread = std::thread( &_::Run, this );
+	}
+
+	CScriptOutput::~CScriptOutput()
+	{
+		{
+			std::lock_guard<std::mutex> Lock( m_hLock );
+			m_bQuit = true;
+		}
+		m_hSignal.notify_all();
+		if( m_hThread.joinable() )
+			m_hThread.join();
+	}
+
+	void CScriptOutput::Run()
+	{
+		std::unique_lock<std::mutex> Lock( m_hLock );
+		for( ;; )
+		{
+			m_hSignal.wait( Lock, [this]{ return m_bQuit || !m_strBuffer.empty(); } );
+			// 退出前把剩下的输出写完
+			if( m_strBuffer.empty() )
+				return;
+
+			// 交换缓冲，写入时不持有锁
+			m_strWriting.swap( m_strBuffer );
+			m_bWriting = true;
+			Lock.unlock();
+			m_pSink->Write( m_strWriting.c_str(), (uint32)m_strWriting.size() );
+			m_strWriting.clear();
+			Lock.lock();
+			m_bWriting = false;
+			m_hSignal.notify_all();
+		}
+	}
+
+	void CScriptOutput::Write( const char* szBuffer, uint32 nSize )
+	{
+		if( !nSize )
+			return;
+		std::lock_guard<std::mutex> Lock( m_hLock );
+		if( m_strBuffer.size() + nSize > m_nMaxBufferSize )
+		{
+			m_nDropSize += nSize;
+			return;
+		}
+		bool bNotify = m_strBuffer.empty();
+		m_strBuffer.append( szBuffer, nSize );
+		if( bNotify )
+			m_hSignal.notify_all();
+	}
+
+	void CScriptOutput::Flush()
+	{
+		std::unique_lock<std::mutex> Lock( m_hLock );
+		m_hSignal.wait( Lock, [this]{ return m_strBuffer.empty() && !m_bWriting; } );
+	}
+}
@@ -0,0 +1,171 @@
+﻿#include <string.h>
+#include <algorithm>
+#include "common/Help.h"
+#include "common/Memory.h"
+#include "core/CScriptPackage.h"
+
+namespace XS
+{
+	static std::string NormalizeName( const char* szFileName )
+	{
+		std::string strName = szFileName;
+		for( size_t i = 0; i < strName.size(); i++ )
+			if( strName[i] == '\\' )
+				strName[i] = '/';
+		strName.resize( ShortPath( &strName[0] ) );
+		return strName;
+	}
+
+	CScriptPackage::CScriptPackage()
+		: m_pMapAddress( NULL )
+		, m_nMapSize( 0 )
+		, m_aryEntry( NULL )
+		, m_nFileCount( 0 )
+	{
+	}
+
+	CScriptPackage::~CScriptPackage()
+	{
+		Close();
+	}
+
+	bool CScriptPackage::Open( const char* szPackage )
+	{
+		Close();
+		size_t nSize = 0;
+		void* pAddress = MapFileToMemory( szPackage, nSize );
+		if( !pAddress )
+			return false;
+
+		// 检查文件头和索引是否越界
+		const SPackageHead* pHead = (const SPackageHead*)pAddress;
+		const SPackageEntry* aryEntry = (const SPackageEntry*)( pHead + 1 );
+		if( nSize < sizeof( SPackageHead ) ||
+			pHead->m_nMagic != ePackageMagic ||
+			pHead->m_nVersion != ePackageVersion ||
+			( nSize - sizeof( SPackageHead ) )/sizeof( SPackageEntry ) < pHead->m_nFileCount )
+		{
+			UnmapFileFromMemory( pAddress, nSize );
+			return false;
+		}
+
+		for( uint32 i = 0; i < pHead->m_nFileCount; i++ )
+		{
+			const SPackageEntry& Entry = aryEntry[i];
+			if( (uint64)Entry.m_nNameOffset + Entry.m_nNameSize <= nSize &&
+				(uint64)Entry.m_nDataOffset + Entry.m_nDataSize <= nSize )
+				continue;
+			UnmapFileFromMemory( pAddress, nSize );
+			return false;
+		}
+
+		m_pMapAddress = pAddress;
+		m_nMapSize = nSize;
+		m_aryEntry = aryEntry;
+		m_nFileCount = pHead->m_nFileCount;
+		return true;
+	}
+
+	void CScriptPackage::Close()
+	{
+		if( !m_pMapAddress )
+			return;
+		UnmapFileFromMemory( m_pMapAddress, m_nMapSize );
+		m_pMapAddress = NULL;
+		m_nMapSize = 0;
+		m_aryEntry = NULL;
+		m_nFileCount = 0;
+	}
+
+	const char* CScriptPackage::Find( const char* szFileName, uint32& nSize ) const
+	{
+		nSize = 0;
+		if( !m_pMapAddress || !szFileName )
+			return NULL;
+
+		const char* pBase = (const char*)m_pMapAddress;
+		uint32 nNameSize = (uint32)strlen( szFileName );
+		uint32 nLow = 0;
+		uint32 nHigh = m_nFileCount;
+		while( nLow < nHigh )
+		{
+			uint32 nMid = ( nLow + nHigh )/2;
+			const SPackageEntry& Entry = m_aryEntry[nMid];
+			uint32 nMinSize = std::min( nNameSize, Entry.m_nNameSize );
+			int32 nCmp = memcmp( szFileName, pBase + Entry.m_nNameOffset, nMinSize );
+			if( nCmp == 0 && nNameSize != Entry.m_nNameSize )
+				nCmp = nNameSize < Entry.m_nNameSize ? -1 : 1;
+			if( nCmp == 0 )
+			{
+				nSize = Entry.m_nDataSize;
+				return pBase + Entry.m_nDataOffset;
+			}
+			if( nCmp < 0 )
+				nHigh = nMid;
+			else
+				nLow = nMid + 1;
+		}
+		return NULL;
+	}
+
+	bool CScriptPackage::Build( const char* szPackage, 
+		const char* szRootPath, const std::vector<std::string>& vecFiles )
+	{
+		std::string strRoot = szRootPath ? szRootPath : "";
+		if( !strRoot.empty() && *strRoot.rbegin() != '/' && *strRoot.rbegin() != '\\' )
+			strRoot.push_back( '/' );
+
+		std::vector<std::string> vecNames;
+		for( size_t i = 0; i < vecFiles.size(); i++ )
+			vecNames.push_back( NormalizeName( vecFiles[i].c_str() ) );
+		std::sort( vecNames.begin(), vecNames.end() );
+		vecNames.erase( std::unique( vecNames.begin(), vecNames.end() ), vecNames.end() );
+
+		SPackageHead Head = { ePackageMagic, ePackageVersion, (uint32)vecNames.size(), 0 };
+		std::vector<SPackageEntry> vecEntry( vecNames.size() );
+		std::string strNames;
+		std::string strDatas;
+		for( size_t i = 0; i < vecNames.size(); i++ )
+		{
+			std::string strFile = strRoot + vecNames[i];
+			FILE* fp = fopen( strFile.c_str(), "rb" );
+			if( !fp )
+				return false;
+			vecEntry[i].m_nNameOffset = (uint32)strNames.size();
+			vecEntry[i].m_nNameSize = (uint32)vecNames[i].size();
+			vecEntry[i].m_nDataOffset = (uint32)strDatas.size();
+			strNames.append( vecNames[i] );
+			strNames.push_back( 0 );
+
+			char szBuffer[4096];
+			size_t nReadSize = 0;
+			while( ( nReadSize = fread( szBuffer, 1, sizeof( szBuffer ), fp ) ) > 0 )
+				strDatas.append( szBuffer, nReadSize );
+			fclose( fp );
+			vecEntry[i].m_nDataSize = (uint32)( strDatas.size() - vecEntry[i].m_nDataOffset );
+			// 以0结尾，方便当做字符串使用
+			strDatas.push_back( 0 );
+		}
+
+		uint64 nNameStart = sizeof( SPackageHead ) + vecEntry.size()*sizeof( SPackageEntry );
+		uint64 nDataStart = nNameStart + strNames.size();
+		if( nDataStart + strDatas.size() > INVALID_32BITID )
+			return false;
+		for( size_t i = 0; i < vecEntry.size(); i++ )
+		{
+			vecEntry[i].m_nNameOffset += (uint32)nNameStart;
+			vecEntry[i].m_nDataOffset += (uint32)nDataStart;
+		}
+
+		FILE* fp = fopen( szPackage, "wb" );
+		if( !fp )
+			return false;
+		fwrite( &Head, sizeof( Head ), 1, fp );
+		if( !vecEntry.empty() )
+			fwrite( &vecEntry[0], sizeof( SPackageEntry ), vecEntry.size(), fp );
+		fwrite( strNames.c_str(), 1, strNames.size(), fp );
+		fwrite( strDatas.c_str(), 1, strDatas.size(), fp );
+		fclose( fp );
+		return true;
+	}
+}
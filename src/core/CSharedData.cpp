@@ -0,0 +1,147 @@
+﻿#include <string.h>
+#include <algorithm>
+#include "common/Help.h"
+#include "core/CSharedData.h"
+
+namespace XS
+{
+	CSharedData::CSharedData( EType eType )
+		: m_eType( eType )
+		, m_bFrozen( false )
+		, m_fValue( 0 )
+	{
+	}
+
+	CSharedData::~CSharedData()
+	{
+		for( size_t i = 0; i < m_vecArray.size(); i++ )
+			delete m_vecArray[i];
+		for( size_t i = 0; i < m_vecMap.size(); i++ )
+			delete m_vecMap[i].second;
+	}
+
+	CSharedData* CSharedData::NewNil()
+	{
+		return new CSharedData( eType_Nil );
+	}
+
+	CSharedData* CSharedData::NewBool( bool bValue )
+	{
+		CSharedData* pData = new CSharedData( eType_Bool );
+		pData->m_bValue = bValue;
+		return pData;
+	}
+
+	CSharedData* CSharedData::NewNumber( double fValue )
+	{
+		CSharedData* pData = new CSharedData( eType_Number );
+		pData->m_fValue = fValue;
+		return pData;
+	}
+
+	CSharedData* CSharedData::NewString( const char* szValue )
+	{
+		CSharedData* pData = new CSharedData( eType_String );
+		pData->m_strValue = szValue ? szValue : "";
+		return pData;
+	}
+
+	CSharedData* CSharedData::NewArray()
+	{
+		return new CSharedData( eType_Array );
+	}
+
+	CSharedData* CSharedData::NewMap()
+	{
+		return new CSharedData( eType_Map );
+	}
+
+	CSharedData* CSharedData::Push( CSharedData* pChild )
+	{
+		assert( m_eType == eType_Array && !m_bFrozen );
+		m_vecArray.push_back( pChild );
+		return pChild;
+	}
+
+	CSharedData* CSharedData::Insert( const char* szKey, CSharedData* pChild )
+	{
+		assert( m_eType == eType_Map && !m_bFrozen );
+		m_vecMap.push_back( CMapItem( szKey, pChild ) );
+		return pChild;
+	}
+
+	void CSharedData::Freeze()
+	{
+		if( m_bFrozen )
+			return;
+		m_bFrozen = true;
+		for( size_t i = 0; i < m_vecArray.size(); i++ )
+			m_vecArray[i]->Freeze();
+		for( size_t i = 0; i < m_vecMap.size(); i++ )
+			m_vecMap[i].second->Freeze();
+
+		// 排序后按二分查找，重复的键只保留最后插入的
+		std::stable_sort( m_vecMap.begin(), m_vecMap.end(), 
+			[]( const CMapItem& l, const CMapItem& r ){ return l.first < r.first; } );
+		for( size_t i = 1; i < m_vecMap.size(); )
+		{
+			if( m_vecMap[i - 1].first != m_vecMap[i].first )
+			{
+				i++;
+				continue;
+			}
+			delete m_vecMap[i - 1].second;
+			m_vecMap.erase( m_vecMap.begin() + ( i - 1 ) );
+		}
+	}
+
+	uint32 CSharedData::GetCount() const
+	{
+		if( m_eType == eType_Array )
+			return (uint32)m_vecArray.size();
+		if( m_eType == eType_Map )
+			return (uint32)m_vecMap.size();
+		return 0;
+	}
+
+	const CSharedData* CSharedData::GetItem( uint32 nIndex ) const
+	{
+		if( m_eType == eType_Array )
+			return nIndex < m_vecArray.size() ? m_vecArray[nIndex] : NULL;
+		if( m_eType == eType_Map )
+			return nIndex < m_vecMap.size() ? m_vecMap[nIndex].second : NULL;
+		return NULL;
+	}
+
+	const char* CSharedData::GetKey( uint32 nIndex ) const
+	{
+		if( m_eType != eType_Map || nIndex >= m_vecMap.size() )
+			return NULL;
+		return m_vecMap[nIndex].first.c_str();
+	}
+
+	int32 CSharedData::FindIndex( const char* szKey ) const
+	{
+		if( m_eType != eType_Map || !szKey )
+			return -1;
+		int32 nLow = 0, nHigh = (int32)m_vecMap.size() - 1;
+		while( nLow <= nHigh )
+		{
+			int32 nMid = ( nLow + nHigh ) >> 1;
+			int32 nCmp = strcmp( m_vecMap[nMid].first.c_str(), szKey );
+			if( nCmp == 0 )
+				return nMid;
+			if( nCmp < 0 )
+				nLow = nMid + 1;
+			else
+				nHigh = nMid - 1;
+		}
+		return -1;
+	}
+
+	const CSharedData* CSharedData::Find( const char* szKey ) const
+	{
+		int32 nIndex = FindIndex( szKey );
+		return nIndex < 0 ? NULL : m_vecMap[nIndex].second;
+	}
+}
@@ -36,6 +36,8 @@ namespace XS
 		, m_pPreState( NULL )
         , m_nBreakFrame( -1 )
 		, m_nValueID( ePDVID_Count )
+		, m_pBreakLineState( NULL )
+		, m_pCurBreakLines( NULL )
 	{
     }
 
@@ -97,15 +99,17 @@ namespace XS
 		auto pScriptLua = CScriptLua::GetScript( pState );
 		auto pDebugger = static_cast<CDebugLua*>( pScriptLua->GetDebugger() );
 
-		// always stop while step in or meet the breakpoint
-		if( pDebugger->m_nBreakFrame == MAX_INT32 ||
-			( lua_getinfo( pState, "lS", pDebug ) &&
-				pDebugger->GetBreakPoint( pDebug->source, pDebug->currentline ) ) )
+		// always stop while step in
+		if( pDebugger->m_nBreakFrame == MAX_INT32 )
 			return pDebugger->Debug( pState );
 
-		// no any frame is expected to be break
+		// no any frame is expected to be break, only check the breakpoints
 		if( pDebugger->m_nBreakFrame < 0 )
-			return;
+			return pDebugger->CheckBreakPoint( pState, pDebug );
+
+		if( lua_getinfo( pState, "lS", pDebug ) &&
+			pDebugger->GetBreakPoint( pDebug->source, pDebug->currentline ) )
+			return pDebugger->Debug( pState );
 
 		// corroutine changed
 		if( pState != pDebugger->m_pState )
@@ -128,6 +132,68 @@ namespace XS
 		pDebugger->Debug( pState );
 	}
 
+	void CDebugLua::CheckBreakPoint( lua_State* pState, lua_Debug* pDebug )
+	{
+		// 行事件只在有断点的文件中打开，这里只需要查位图
+		if( pDebug->event == LUA_HOOKLINE && pState == m_pBreakLineState )
+		{
+			uint32 nLine = (uint32)pDebug->currentline;
+			if( m_pCurBreakLines && nLine/32 < m_pCurBreakLines->size() &&
+				( ( *m_pCurBreakLines )[nLine/32] & ( 1u << ( nLine%32 ) ) ) )
+				Debug( pState );
+			return;
+		}
+
+		// 进入函数时看被调用函数，返回时看调用者，决定是否需要行事件
+		const CLineBitmap* pLines = NULL;
+		if( pDebug->event == LUA_HOOKCALL || pDebug->event == LUA_HOOKLINE )
+		{
+			lua_getinfo( pState, "S", pDebug );
+			pLines = GetBreakLines( pDebug->source );
+		}
+		else
+		{
+			lua_Debug Caller;
+			if( lua_getstack( pState, 1, &Caller ) && lua_getinfo( pState, "S", &Caller ) )
+				pLines = GetBreakLines( Caller.source );
+		}
+
+		m_pBreakLineState = pState;
+		m_pCurBreakLines = pLines;
+		static_cast<CScriptLua*>( GetScriptBase() )->SetHookMask( pState, 
+			LUA_MASKCALL|LUA_MASKRET|( pLines ? LUA_MASKLINE : 0 ) );
+
+		if( pDebug->event == LUA_HOOKLINE && pLines )
+			CheckBreakPoint( pState, pDebug );
+	}
+
+	void CDebugLua::UpdateBreakLines()
+	{
+		m_mapBreakLines.clear();
+		m_pBreakLineState = NULL;
+		m_pCurBreakLines = NULL;
+		for( auto it = m_setBreakPoint.begin(); it != m_setBreakPoint.end(); ++it )
+		{
+			CLineBitmap& vecBitmap = m_mapBreakLines[it->GetModuleName()];
+			uint32 nLine = it->GetLineNum();
+			if( nLine/32 >= vecBitmap.size() )
+				vecBitmap.resize( nLine/32 + 1 );
+			vecBitmap[nLine/32] |= 1u << ( nLine%32 );
+		}
+	}
+
+	const CDebugLua::CLineBitmap* CDebugLua::GetBreakLines( const char* szSource )
+	{
+		if( !szSource || szSource[0] != '@' )
+			return NULL;
+		const char* szModule = ++szSource;
+		for( const char* pCur = szSource; *pCur; pCur++ )
+			if( *pCur == '\\' || *pCur == '/' )
+				szModule = pCur + 1;
+		auto it = m_mapBreakLines.find( const_string( szModule, true ) );
+		return it == m_mapBreakLines.end() ? NULL : &it->second;
+	}
+
 	void CDebugLua::ClearVariables()
 	{
 		while( m_mapVariable.GetFirst() )
@@ -144,7 +210,7 @@ namespace XS
 	void CDebugLua::Debug( lua_State* pState )
 	{
 		m_pState = pState;
-		lua_sethook( pState, &CDebugLua::DebugHook, 0, 0 );
+		static_cast<CScriptLua*>( GetScriptBase() )->SetHookMask( pState, 0 );
 		CDebugBase::Debug();
 
 		ClearVariables();
@@ -161,21 +227,23 @@ namespace XS
 	uint32 CDebugLua::AddBreakPoint( const char* szFileName, int32 nLine )
 	{
 		uint32 nID = CDebugBase::AddBreakPoint( szFileName, nLine );
+		UpdateBreakLines();
 		CScriptLua* pScriptLua = static_cast<CScriptLua*>( GetScriptBase() );
 		lua_State* pState = pScriptLua->GetLuaState();
 		if( HaveBreakPoint() )
-			lua_sethook( pState, &CDebugLua::DebugHook, LUA_MASKALL, 0 );
+			pScriptLua->SetHookMask( pState, LUA_MASKALL );
 		return nID;
 	}
 
 	void CDebugLua::DelBreakPoint( uint32 nBreakPointID )
 	{
 		CDebugBase::DelBreakPoint( nBreakPointID );
+		UpdateBreakLines();
 		CScriptLua* pScriptLua = static_cast<CScriptLua*>( GetScriptBase() );
 		lua_State* pState = pScriptLua->GetLuaState();
 		if( HaveBreakPoint() || m_nBreakFrame >= 0 )
 			return;
-		lua_sethook( pState, &CDebugLua::DebugHook, 0, 0 );
+		pScriptLua->SetHookMask( pState, 0 );
 	}
 
 	void CDebugLua::Stop()
@@ -189,28 +257,29 @@ namespace XS
 	{
 		if( !HaveBreakPoint() )
 			return;
-		lua_sethook( m_pState, &CDebugLua::DebugHook, LUA_MASKALL, 0 );
+		static_cast<CScriptLua*>( GetScriptBase() )->SetHookMask( m_pState, LUA_MASKALL );
 		m_nBreakFrame = -1;
 		m_pPreState = m_pState;
+		m_pBreakLineState = NULL;
 	}
 
     void CDebugLua::StepNext()
     {
-        lua_sethook( m_pState, &CDebugLua::DebugHook, LUA_MASKLINE, 0 );
+        static_cast<CScriptLua*>( GetScriptBase() )->SetHookMask( m_pState, LUA_MASKLINE );
 		m_nBreakFrame = GetFrameCount();
 		m_pPreState = m_pState;
     }
 
     void CDebugLua::StepIn()
     {
-        lua_sethook( m_pState, &CDebugLua::DebugHook, LUA_MASKALL, 0 );
+        static_cast<CScriptLua*>( GetScriptBase() )->SetHookMask( m_pState, LUA_MASKALL );
 		m_nBreakFrame = MAX_INT32;
 		m_pPreState = m_pState;
     }
 
     void CDebugLua::StepOut()
     {
-        lua_sethook( m_pState, &CDebugLua::DebugHook, LUA_MASKLINE|LUA_MASKRET, 0 );
+        static_cast<CScriptLua*>( GetScriptBase() )->SetHookMask( m_pState, LUA_MASKLINE|LUA_MASKRET );
 		m_nBreakFrame = (int32)GetFrameCount() - 1;
 		m_pPreState = m_pState;
     }
@@ -10,6 +10,7 @@
 #include "common/TRBTree.h"
 #include "core/CDebugBase.h"
 #include <vector>
+#include <map>
 
 struct lua_State;
 struct lua_Debug;
@@ -41,6 +42,9 @@ namespace XS
 
 		struct SVariableNode : public SFieldInfo, public SVariableInfo {};
 
+		typedef std::vector<uint32> CLineBitmap;
+		typedef std::map<const_string, CLineBitmap> CBreakLineMap;
+
         lua_State*			m_pState;
 		lua_State*			m_pPreState;
         int32				m_nBreakFrame;
@@ -48,12 +52,21 @@ namespace XS
 		uint32				m_nValueID;
 		CVariableMap		m_mapVariable;
 
+		CBreakLineMap		m_mapBreakLines;
+		lua_State*			m_pBreakLineState;
+		const CLineBitmap*	m_pCurBreakLines;
+
         static void			DebugHook( lua_State *pState, lua_Debug* pDebug );
 		void				Debug( lua_State* pState );
+		void				CheckBreakPoint( lua_State* pState, lua_Debug* pDebug );
+		void				UpdateBreakLines();
+		const CLineBitmap*	GetBreakLines( const char* szSource );
 
 		void				ClearVariables();
 		uint32				TouchVariable( const char* szField, uint32 nParentID );
 		virtual uint32		GenBreakPointID( const char* szFileName, int32 nLine );
+
+		friend class CScriptLua;
     public:
         CDebugLua( CScriptBase* pBase, uint16 nDebugPort );
         ~CDebugLua(void);
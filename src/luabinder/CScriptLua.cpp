@@ -5,7 +5,6 @@
 #include <alloca.h>
 #endif
 #include <locale>
-#include <codecvt>
 
 #undef min
 #undef max
@@ -18,11 +17,14 @@ extern "C"
 	#include "lualib.h"
 }
 
+#include "common/UtfConvert.h"
 #include "CTypeLua.h"
 #include "CDebugLua.h"
 #include "CScriptLua.h"
 #include "core/CCallInfo.h"
 #include "core/CClassInfo.h"
+#include "core/CSharedData.h"
+#include "core/CScriptSerial.h"
 
 namespace XS
 {
@@ -33,10 +35,23 @@ namespace XS
 	void* CScriptLua::ms_pRegistScriptLuaKey	= (void*)"__regist_cscript_lua";
 	void* CScriptLua::ms_pErrorHandlerKey		= (void*)"__error_handler";
 	void* CScriptLua::ms_pClassInfoKey			= (void*)"__class_info";
+	void* CScriptLua::ms_pChunkCacheKey			= (void*)"__chunk_cache";
+	void* CScriptLua::ms_pCoroutineKey			= (void*)"__coroutine_table";
+	void* CScriptLua::ms_pSharedDataKey			= (void*)"__shared_data_proxy";
+	void* CScriptLua::ms_pSharedMetaKey			= (void*)"__shared_data_meta";
+	void* CScriptLua::ms_pBoundStatKey			= (void*)"__bound_stat";
+	void* CScriptLua::ms_pBoundMetaKey			= (void*)"__bound_stat_meta";
 
     CScriptLua::CScriptLua( uint16 nDebugPort )
         : m_pAllAllocBlock( NULL )
 		, m_bPreventExeInRunBuffer( false )
+		, m_nHookCount( 0 )
+		, m_nProfileInterval( 0 )
+		, m_nProfileTick( 0 )
+		, m_nCoroutineID( 0 )
+		, m_pYieldState( NULL )
+		, m_bBudgetHook( false )
+		, m_bDebugLine( false )
 	{
 		memset( m_aryBlock, 0, sizeof(m_aryBlock) );
 		lua_State* pL = lua_newstate( &CScriptLua::Realloc, this );
@@ -46,9 +61,6 @@ namespace XS
 		luaL_openlibs( pL );
 
 		m_pDebugger = new CDebugLua( this, nDebugPort );
-#ifdef _DEBUG
-		SetDebugLine();
-#endif
 
 		lua_atpanic( pL, &CScriptLua::Panic );
 		//Redirect2Console( stdin, stdout, stderr );
@@ -150,6 +162,81 @@ namespace XS
             "	return NewClass\n"
             "end\n"
 
+			// 热更新：重新执行文件后，新的类合并到旧的类表，已有的实例直接使用新函数
+			// 只处理放在_G或者package.loaded里的类：模块本身是类，或者模块表的字段是类
+			"local __reload_snapshot = nil\n"
+			"local function __reload_collect( snapshot, path, tbl )\n"
+			"	for k, v in pairs( tbl ) do\n"
+			"		if type( v ) == \"table\" and rawget( v, \"__derive_list\" ) then\n"
+			"			snapshot[#snapshot + 1] = { path, k, v }\n"
+			"		end\n"
+			"	end\n"
+			"end\n"
+			// path为false表示_G，true表示package.loaded，字符串表示该模块的表
+			"local function __reload_container( path )\n"
+			"	if path == false then\n"
+			"		return _G\n"
+			"	end\n"
+			"	if path == true then\n"
+			"		return package.loaded\n"
+			"	end\n"
+			"	local module = package.loaded[path]\n"
+			"	return type( module ) == \"table\" and module or nil\n"
+			"end\n"
+			"function __reload_begin()\n"
+			"	__reload_snapshot = {}\n"
+			"	__reload_collect( __reload_snapshot, false, _G )\n"
+			"	for name, module in pairs( package.loaded ) do\n"
+			"		if type( module ) == \"table\" and module ~= _G then\n"
+			"			if rawget( module, \"__derive_list\" ) then\n"
+			"				__reload_snapshot[#__reload_snapshot + 1] = { true, name, module }\n"
+			"			else\n"
+			"				__reload_collect( __reload_snapshot, name, module )\n"
+			"			end\n"
+			"		end\n"
+			"	end\n"
+			"end\n"
+			"local function __reload_merge( old, new )\n"
+			"	local old_vt = rawget( old, \"__index\" )\n"
+			"	for key, value in pairs( rawget( new, \"__index\" ) ) do\n"
+			"		if key ~= \"class\" and key ~= \"GetClass\" and key ~= \"IsInheritFrom\" then\n"
+			"			__derive_to_child( old, key, value, rawget( old_vt, key ) )\n"
+			"		end\n"
+			"	end\n"
+			"	for key, value in pairs( new ) do\n"
+			"		if key ~= \"__index\" and key ~= \"__base_list\" and key ~= \"__derive_list\" and\n"
+			"			key ~= \"new\" and key ~= \"GetSuperClass\" then\n"
+			"			rawset( old, key, value )\n"
+			"		end\n"
+			"	end\n"
+			"	local base_list = rawget( new, \"__base_list\" )\n"
+			"	for i = 1, #base_list do\n"
+			"		local derive_list = base_list[i].__derive_list\n"
+			"		for j = #derive_list, 1, -1 do\n"
+			"			if derive_list[j] == new then\n"
+			"				table.remove( derive_list, j )\n"
+			"			end\n"
+			"		end\n"
+			"	end\n"
+			"end\n"
+			"function __reload_end()\n"
+			"	local snapshot = __reload_snapshot or {}\n"
+			"	__reload_snapshot = nil\n"
+			"	local merged = {}\n"
+			"	for i = 1, #snapshot do\n"
+			"		local path, k, old = snapshot[i][1], snapshot[i][2], snapshot[i][3]\n"
+			"		local container = __reload_container( path )\n"
+			"		local new = container and rawget( container, k )\n"
+			"		if new ~= old and type( new ) == \"table\" and rawget( new, \"__derive_list\" ) then\n"
+			"			if not merged[new] then\n"
+			"				__reload_merge( old, new )\n"
+			"				merged[new] = true\n"
+			"			end\n"
+			"			rawset( container, k, old )\n"
+			"		end\n"
+			"	end\n"
+			"end\n"
+
             //在继承树上检查check_node是否cur_node的基类，不是则不能进行类型转换
             //如果是，还要检查在cur_node继承树上是否有和check_node内存不连续的基类
             //如果有，也不能进行类型转换
@@ -257,6 +344,32 @@ namespace XS
         lua_setmetatable( pL, -2 );
 		lua_rawset( pL, LUA_REGISTRYINDEX );   
 
+		//RunString的代码块，由CScriptBase的LRU决定何时释放
+		lua_pushlightuserdata( pL, CScriptLua::ms_pChunkCacheKey );
+		lua_newtable( pL );
+		lua_rawset( pL, LUA_REGISTRYINDEX );
+
+		//共享数据的代理对象，同一个节点只有一个代理
+		lua_pushlightuserdata( pL, CScriptLua::ms_pSharedDataKey );
+		lua_newtable( pL );
+		lua_newtable( pL );
+		lua_pushstring( pL, "v");
+		lua_setfield( pL, -2, "__mode");
+		lua_setmetatable( pL, -2 );
+		lua_rawset( pL, LUA_REGISTRYINDEX );
+
+		//C++创建的对象的包装表上挂的统计哨兵，包装表被回收时减去统计
+		lua_pushlightuserdata( pL, CScriptLua::ms_pBoundMetaKey );
+		lua_newtable( pL );
+		lua_pushcfunction( pL, &CScriptLua::BoundStatGC );
+		lua_setfield( pL, -2, "__gc" );
+		lua_rawset( pL, LUA_REGISTRYINDEX );
+
+		//StartCoroutine创建的协程，结束或被杀掉前不能被回收
+		lua_pushlightuserdata( pL, CScriptLua::ms_pCoroutineKey );
+		lua_newtable( pL );
+		lua_rawset( pL, LUA_REGISTRYINDEX );
+
 		lua_pushlightuserdata( pL, ms_pErrorHandlerKey );
 		lua_pushcfunction( pL, &CScriptLua::ErrorHandler );
 		lua_rawset( pL, LUA_REGISTRYINDEX );
@@ -267,11 +380,14 @@ namespace XS
         lua_register( pL, "__cpp_cast",	&CScriptLua::ClassCast );
         lua_register( pL, "gdb",		&CScriptLua::DebugBreak );
 		lua_register( pL, "BTrace",		&CScriptLua::BackTrace );
+		lua_register( pL, "Serialize",	&CScriptLua::Serialize );
+		lua_register( pL, "Deserialize",	&CScriptLua::Deserialize );
 
 		AddLoader();
 		IO_Replace();
 
 		RegisterPointerClass( this );
+		RegisterInt64Class( this );
 		lua_register( pL, "print",		&CScriptLua::Print );
 		lua_register( pL, "tostring",	&CScriptLua::ToString );
 
@@ -495,7 +611,7 @@ namespace XS
     // 通用函数
     //--------------------------------------------------------------------------------
     // Lua stack 堆栈必须只有一个值，类（表,在栈底）.调用后， stack top = 1, 对象对应的表在栈顶
-    void* CScriptLua::NewLuaObj( lua_State* pL, const CClassInfo* pInfo )
+    void* CScriptLua::NewLuaObj( lua_State* pL, const CClassInfo* pInfo, EObjectStat eStat )
     {
 		lua_pushstring( pL, pInfo->GetObjectIndex().c_str() );
         void* pObj = lua_newuserdata( pL, pInfo->GetClassSize() );
@@ -505,6 +621,9 @@ namespace XS
 		lua_pushlightuserdata( pL, ms_pClassInfoKey );
 		lua_pushlightuserdata( pL, (void*)pInfo );
 		lua_rawset( pL, -3 );
+		lua_pushinteger( pL, eStat );
+		lua_setfield( pL, -2, "_stat" );
+		GetScript( pL )->AddObjectStat( pInfo, eStat, 1 );
 		lua_pushcfunction( pL, ObjectGC );
 		lua_setfield( pL, -2, "__gc");
 		lua_setmetatable( pL, -2 );            //setmetatable( userdata, mt )
@@ -567,20 +686,62 @@ namespace XS
 		lua_rawget( L, LUA_REGISTRYINDEX );						
         RegistToLua( L, pInfo, pObj, nObj + 1, nObj );
         lua_pop( L, 1 );        //弹出CScriptLua::ms_szGlobObjectTable    
+		if( bGC )
+			return;
+
+		// 虚拟机创建的对象做类型转换时也会到这里，只统计C++创建的对象
+		lua_pushstring( L, pInfo->GetObjectIndex().c_str() );
+		lua_rawget( L, nObj );
+		bool bBound = lua_islightuserdata( L, -1 ) != 0;
+		lua_pop( L, 1 );
+		BindObjectStat( L, nObj, bBound ? pInfo : NULL );
     }
 
+	void CScriptLua::BindObjectStat( lua_State* pL, int32 nObj, const CClassInfo* pInfo )
+	{
+		// 哨兵记录包装表当前统计在哪个类上，pInfo为NULL表示不再统计
+		CScriptLua* pScript = GetScript( pL );
+		lua_pushlightuserdata( pL, ms_pBoundStatKey );
+		lua_rawget( pL, nObj );
+		auto ppStat = (const CClassInfo**)lua_touserdata( pL, -1 );
+		lua_pop( pL, 1 );
+		if( ppStat && *ppStat )
+			pScript->AddObjectStat( *ppStat, eObjStat_Bound, -1 );
+		if( pInfo )
+			pScript->AddObjectStat( pInfo, eObjStat_Bound, 1 );
+		if( ppStat )
+		{
+			*ppStat = pInfo;
+			return;
+		}
+		if( !pInfo )
+			return;
+
+		lua_pushlightuserdata( pL, ms_pBoundStatKey );
+		ppStat = (const CClassInfo**)lua_newuserdata( pL, sizeof( const CClassInfo* ) );
+		*ppStat = pInfo;
+		lua_pushlightuserdata( pL, ms_pBoundMetaKey );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		lua_setmetatable( pL, -2 );
+		lua_rawset( pL, nObj );
+	}
+
+	int32 CScriptLua::BoundStatGC( lua_State* pL )
+	{
+		auto ppStat = (const CClassInfo**)lua_touserdata( pL, 1 );
+		if( ppStat && *ppStat )
+			GetScript( pL )->AddObjectStat( *ppStat, eObjStat_Bound, -1 );
+		return 0;
+	}
+
 	void CScriptLua::NewUnicodeString( lua_State* pL, const wchar_t* szStr )
 	{
 		if( szStr == NULL )
 			return lua_pushnil( pL );
 		CScriptLua* pScript = CScriptLua::GetScript( pL );
 		size_t nSize = wcslen( szStr );
-		pScript->m_szTempUtf8.resize( nSize * 6 );
-		static std::codecvt_utf8<wchar_t> UtfCvt;
-		std::codecvt_utf8<wchar_t>::state_type State{};
-		char* szUtf = &pScript->m_szTempUtf8[0];
-		UtfCvt.out( State, szStr, szStr + nSize, szStr, szUtf, szUtf + nSize * 6, szUtf );
-		size_t nLen = (size_t)( szUtf - &pScript->m_szTempUtf8[0] );
+		pScript->m_szTempUtf8.resize( nSize * 4 + 1 );
+		size_t nLen = UcsToUtf8( &pScript->m_szTempUtf8[0], szStr, nSize );
 		lua_pushlstring( pL, pScript->m_szTempUtf8.c_str(), nLen );
 	}
 
@@ -596,11 +757,7 @@ namespace XS
 		CScriptLua* pScript = CScriptLua::GetScript( pL );
 		size_t nSize = strlen( szStr );
 		pScript->m_szTempUcs2.resize( nSize + 1 );
-		static std::codecvt_utf8<wchar_t> UtfCvt;
-		std::codecvt_utf8<wchar_t>::state_type State{};
-		wchar_t* szUcs = &pScript->m_szTempUcs2[0];
-		UtfCvt.in( State, szStr, szStr + nSize, szStr, szUcs, szUcs + nSize, szUcs );
-		size_t nLen = (size_t)( szUcs - &pScript->m_szTempUcs2[0] );
+		size_t nLen = Utf8ToUcs( &pScript->m_szTempUcs2[0], szStr, nSize );
 		pScript->m_szTempUcs2.resize( nLen );
 		const char* szUcsBuffer = (const char*)&pScript->m_szTempUcs2[0];
 		lua_pushlstring( pL, szUcsBuffer, ( nLen + 1 )*sizeof(wchar_t) );
@@ -618,12 +775,16 @@ namespace XS
         lua_rawget( pL, -2 );
 		const CClassInfo* pInfo = (const CClassInfo*)lua_touserdata( pL, -1 );
 		void* pObject = (void*)lua_touserdata( pL, -3 );
+		lua_getfield( pL, -2, "_stat" );
+		EObjectStat eStat = (EObjectStat)lua_tointeger( pL, -1 );
+		lua_pop( pL, 1 );
 		// 不需要调用UnRegisterObject，仅仅恢复虚表即可，
 		// 因为已经被回收，所以不存在还有任何地方会引用到此对象
 		// 调用UnRegisterObject反而会导致gc问题（table[obj] = nil 会crash）
 		CScriptLua* pScriptLua = GetScript(pL);
 		pInfo->RecoverVirtualTable( pScriptLua, pObject );
 		pInfo->Destruct( pScriptLua, pObject );
+		pScriptLua->AddObjectStat( pInfo, eStat, -1 );
         lua_pop( pL, 3 );
         return 0;
     }
@@ -776,6 +937,11 @@ namespace XS
 				}
 			}
 			pScript->PopLuaState();
+			if( pScript->m_pYieldState == pL )
+			{
+				pScript->m_pYieldState = NULL;
+				return lua_yield( pL, 0 );
+			}
 			return 1;
 		}
 		catch( std::exception& exp )
@@ -784,6 +950,8 @@ namespace XS
 			sprintf( szBuf, "An unknow exception occur on calling %s\n", 
 				pCallBase->GetFunctionName().c_str() );
 			pScript->Output( szBuf, -1 );
+			pScript->m_pYieldState = NULL;
+			pScript->PopLuaState();
 			luaL_error( pL, exp.what() );
 		}
 		catch( ... )
@@ -792,10 +960,10 @@ namespace XS
 			sprintf( szBuf, "An unknow exception occur on calling %s\n", 
 				pCallBase->GetFunctionName().c_str() );
 			pScript->Output( szBuf, -1 );
+			pScript->m_pYieldState = NULL;
+			pScript->PopLuaState();
 			luaL_error( pL, szBuf );
 		}
-
-		pScript->PopLuaState();
 		return 0;
 	}    
 	
@@ -884,8 +1052,9 @@ namespace XS
 				const char* szFileName = luaL_checkstring( pL, 1 );
 				if( szFileName == NULL || szFileName[0] == 0 )
 					return 1;
-				std::wstring_convert<std::codecvt_utf8<wchar_t>> _wstr;
-				std::wstring strName = _wstr.from_bytes( szFileName );
+				size_t nLen = strlen( szFileName );
+				std::wstring strName( nLen + 1, 0 );
+				strName.resize( Utf8ToUcs( &strName[0], szFileName, nLen ) );
 				assert( strName.size() < 1024 );
 				char szAcsName[4096];
 				WideCharToMultiByte( CP_ACP, NULL, strName.c_str(), -1, 
@@ -921,6 +1090,8 @@ namespace XS
 		CScriptLua* pScriptLua = GetScript( pL );
 		int n = lua_gettop( pL );  /* number of arguments */
 		int i;
+		// 整行一次输出，缓冲满时整行丢弃，不会只留下半行
+		std::string strLine;
 		lua_getglobal( pL, "tostring");
 		for( i = 1; i <= n; i++ )
 		{
@@ -934,11 +1105,12 @@ namespace XS
 				return luaL_error( pL, LUA_QL("tostring") 
 					" must return a string to " LUA_QL("print") );
 			if( i > 1 )
-				pScriptLua->Output( "\t", -1 );
-			pScriptLua->Output( s, -1 );
+				strLine.push_back( '\t' );
+			strLine.append( s, lua_objlen( pL, -1 ) );
 			lua_pop( pL, 1 );  /* pop result */
 		}
-		pScriptLua->Output( "\n", -1 );
+		strLine.push_back( '\n' );
+		pScriptLua->Output( strLine.c_str(), (int)strLine.size() );
 		return 0;
 	}
 
@@ -1145,6 +1317,101 @@ namespace XS
 		 return false;
 	 }
 
+	 bool CScriptLua::BindClass( lua_State* pL, const CClassInfo* pInfo )
+	 {
+		 // 已经绑定过的类直接返回
+		 const char* szClass = pInfo->GetClassName().c_str();
+		 assert( szClass && szClass[0] );
+		 lua_pushstring( pL, szClass );
+		 lua_rawget( pL, LUA_GLOBALSINDEX );
+		 if( !lua_isnil( pL, -1 ) )
+			 return true;
+		 lua_pop( pL, 1 );
+
+		 lua_getglobal( pL, "class" );
+		 assert( !lua_isnil( pL, -1 ) );
+
+		 // 基类必须先于子类绑定，否则子类无法继承基类的函数
+		 for( size_t i = 0; i < pInfo->BaseRegist().size(); i++ )
+		 {
+			 auto pBaseInfo = pInfo->BaseRegist()[i].m_pBaseInfo;
+			 assert( pBaseInfo != NULL );
+			 BindClass( pL, pBaseInfo );
+			 assert( !lua_isnil( pL, -1 ) ); 
+		 }
+
+		 lua_call( pL, (int32)pInfo->BaseRegist().size(), 1 );
+		 int nClassIdx = lua_gettop( pL );
+		 lua_pushstring( pL, szClass );
+		 lua_pushvalue( pL, nClassIdx );
+		 lua_rawset( pL, LUA_GLOBALSINDEX );
+
+		 lua_pushstring( pL, "_info" );
+		 lua_pushlightuserdata( pL, (void*)pInfo );
+		 lua_rawset( pL, nClassIdx );
+
+		 lua_pushstring( pL, "__gc" );
+		 lua_pushcfunction( pL, ObjectGC );
+		 lua_rawset( pL, nClassIdx );
+
+		 lua_pushlightuserdata( pL, (void*)pInfo );
+		 lua_pushcclosure( pL, CScriptLua::ObjectConstruct, 1 );
+		 lua_setfield( pL, nClassIdx, "construction" );
+
+		 const CCallBaseMap& mapFunction = pInfo->GetRegistFunction();
+		 for( auto pCall = mapFunction.GetFirst(); pCall; pCall = pCall->GetNext() )
+		 {
+			 lua_pushlightuserdata( pL, pCall );
+			 lua_pushcclosure( pL, CScriptLua::CallByLua, 1 );
+			 lua_setfield( pL, nClassIdx, pCall->GetFunctionName().c_str() );
+		 }
+
+		 if( pInfo->IsTableConvert() )
+		 {
+			 lua_pushlightuserdata( pL, (void*)pInfo );
+			 lua_pushcclosure( pL, CScriptLua::ToTable, 1 );
+			 lua_setfield( pL, nClassIdx, "ToTable" );
+			 lua_pushlightuserdata( pL, (void*)pInfo );
+			 lua_pushcclosure( pL, CScriptLua::FromTable, 1 );
+			 lua_setfield( pL, nClassIdx, "FromTable" );
+		 }
+		 return true;
+	 }
+
+	 int32 CScriptLua::LazyBindClass( lua_State* pL )
+	 {
+		 // _G的__index，只有访问不存在的全局变量时才会进来
+		 if( lua_type( pL, 2 ) == LUA_TSTRING )
+		 {
+			 CScriptLua* pScript = GetScript( pL );
+			 const_string strName( lua_tostring( pL, 2 ), true );
+			 auto it = pScript->m_mapClassName.find( strName );
+			 if( it != pScript->m_mapClassName.end() )
+			 {
+				 BindClass( pL, it->second );
+				 return 1;
+			 }
+		 }
+
+		 // 不是C++类，交给_G原有的__index
+		 int32 nType = lua_type( pL, lua_upvalueindex( 1 ) );
+		 if( nType == LUA_TFUNCTION )
+		 {
+			 lua_pushvalue( pL, lua_upvalueindex( 1 ) );
+			 lua_pushvalue( pL, 1 );
+			 lua_pushvalue( pL, 2 );
+			 lua_call( pL, 2, 1 );
+			 return 1;
+		 }
+		 if( nType == LUA_TTABLE )
+		 {
+			 lua_pushvalue( pL, 2 );
+			 lua_gettable( pL, lua_upvalueindex( 1 ) );
+			 return 1;
+		 }
+		 return 0;
+	 }
+
 	 void CScriptLua::BuildRegisterInfo()
 	 {
 		lua_State* pL = GetLuaState();
@@ -1154,49 +1421,18 @@ namespace XS
 			 if( pInfo->IsEnum() )
 				 continue;
 
-			 const CCallBaseMap& mapFunction = pInfo->GetRegistFunction();
+			 // 类只记录名字，第一次被脚本访问或者对象被压栈时才绑定
 			 const char* szClass = pInfo->GetClassName().c_str();
 			 if( szClass && szClass[0] )
 			 {
-				 lua_getglobal( pL, "class" );
-				 assert( !lua_isnil( pL, -1 ) );
-
-				 int nClassIdx = lua_gettop( pL );
-				 lua_getglobal( pL, szClass );
-				 assert( lua_isnil( pL, -1 ) );
-				 lua_pop( pL, 1 ); 
-
-				 for( size_t i = 0; i < pInfo->BaseRegist().size(); i++ )
-				 {
-					 auto pBaseInfo = pInfo->BaseRegist()[i].m_pBaseInfo;
-					 assert( pBaseInfo != NULL );
-					 lua_getglobal( pL, pBaseInfo->GetClassName().c_str() );
-					 assert( !lua_isnil( pL, -1 ) ); 
-				 }
-
-				 lua_call( pL, (int32)pInfo->BaseRegist().size(), 1 );
-				 lua_pushvalue( pL, -1 );
-				 lua_setglobal( pL, szClass );           
-
-				 lua_pushstring( pL, "_info" );
-				 lua_pushlightuserdata( pL, pInfo );
-				 lua_rawset( pL, nClassIdx );
-
-				 lua_pushstring( pL, "__gc" );
-				 lua_pushcfunction( pL, ObjectGC );
-				 lua_rawset( pL, nClassIdx );
-
-				 lua_pushlightuserdata( pL, pInfo );
-				 lua_pushcclosure( pL, CScriptLua::ObjectConstruct, 1 );
-				 lua_setfield( pL, nClassIdx, "construction" );
-			 }
-			 else
-			 {
-				lua_getglobal( pL, "_G" );
+				 m_mapClassName[pInfo->GetClassName()] = pInfo;
+				 continue;
 			 }
 
+			 lua_getglobal( pL, "_G" );
 			 assert( !lua_isnil( pL, -1 ) );
 
+			 const CCallBaseMap& mapFunction = pInfo->GetRegistFunction();
 			 for( auto pCall = mapFunction.GetFirst(); pCall; pCall = pCall->GetNext() )
 			 {
 				 lua_pushlightuserdata( pL, pCall );
@@ -1205,34 +1441,186 @@ namespace XS
 			 }
 			 lua_pop( pL, 1 );
 		 }
+
+		 // _G已有metatable时保留它，原来的__index作为upvalue串在后面
+		 // 之后再替换_G的__index的脚本（比如strict.lua）需要自己串上原来的__index
+		 lua_pushvalue( pL, LUA_GLOBALSINDEX );
+		 if( !lua_getmetatable( pL, -1 ) )
+		 {
+			 lua_newtable( pL );
+			 lua_pushvalue( pL, -1 );
+			 lua_setmetatable( pL, -3 );
+		 }
+		 lua_getfield( pL, -1, "__index" );
+		 lua_pushcclosure( pL, &CScriptLua::LazyBindClass, 1 );
+		 lua_setfield( pL, -2, "__index" );
+		 lua_pop( pL, 2 );
 	 }
 
+	//=========================================================================
+	// 钩子：每个lua_State只有一个钩子，调试器、采样和执行预算共用
+	//=========================================================================
 #ifdef _DEBUG
 	 uint32 g_nIndex = 0;
 	 std::pair<const char*, uint32> g_aryLog[1024];
+#endif
 
-	 void CScriptLua::DebugHookProc( lua_State *pState, lua_Debug* pDebug )
-	 {
-		 static bool bOut = false;
-		 if( bOut )
-		 {
-			 lua_getinfo ( pState, "S", pDebug );
-			 if( strncmp( s_CacheTruckPrefix.c_str(), pDebug->source + 1, 13 ) )
-			 {
-				 lua_getinfo ( pState, "l", pDebug );
-				 uint32 nIndex = ( g_nIndex++ )%1024;
-				 g_aryLog[nIndex].first = pDebug->source;
-				 g_aryLog[nIndex].second = pDebug->currentline;
-			 }
-		 }
-		 lua_sethook( pState, &DebugHookProc, LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE, 0 );
-	 }
-
-	 void CScriptLua::SetDebugLine()
-	 {
-		 lua_sethook( GetLuaState(), &DebugHookProc, LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE, 0 );
-	 }
+	void CScriptLua::HookProc( lua_State *pState, lua_Debug* pDebug )
+	{
+		if( pDebug->event != LUA_HOOKCOUNT )
+		{
+#ifdef _DEBUG
+			if( pDebug->event == LUA_HOOKLINE && GetScript( pState )->m_bDebugLine &&
+				lua_getinfo( pState, "Sl", pDebug ) &&
+				strncmp( s_CacheTruckPrefix.c_str(), pDebug->source + 1, s_CacheTruckPrefix.size() ) )
+			{
+				uint32 nIndex = ( g_nIndex++ )%1024;
+				g_aryLog[nIndex].first = pDebug->source;
+				g_aryLog[nIndex].second = pDebug->currentline;
+			}
 #endif
+			return CDebugLua::DebugHook( pState, pDebug );
+		}
+
+		// 协程创建时从父状态复制钩子，计数可能已经过期
+		CScriptLua* pScript = GetScript( pState );
+		uint32 nCount = (uint32)lua_gethookcount( pState );
+		if( nCount != pScript->m_nHookCount )
+			return pScript->RefreshHook( pState );
+
+		// 超时后改为每条指令都报错，脚本里的pcall拦住一次也会马上再报，直到回到C++
+		if( pScript->m_bBudgetHook && pScript->CheckBudget() )
+		{
+			if( pScript->m_nHookCount != 1 )
+				pScript->UpdateHookCount();
+			pScript->RefreshHook( pState );
+			luaL_error( pState, "execution budget exceeded" );
+		}
+
+		if( !pScript->m_nProfileInterval )
+			return;
+		pScript->m_nProfileTick += nCount;
+		if( pScript->m_nProfileTick < pScript->m_nProfileInterval )
+			return;
+		pScript->m_nProfileTick -= pScript->m_nProfileInterval;
+		pScript->SampleStack( pState );
+	}
+
+	void CScriptLua::SetHookMask( lua_State* pState, int32 nEventMask )
+	{
+		// 调用者只决定call/ret/line事件，count事件由采样和执行预算决定
+		nEventMask &= ~LUA_MASKCOUNT;
+		if( m_bDebugLine )
+			nEventMask |= LUA_MASKCALL|LUA_MASKRET|LUA_MASKLINE;
+		if( m_nHookCount )
+			nEventMask |= LUA_MASKCOUNT;
+		lua_Hook funHook = nEventMask ? &HookProc : NULL;
+		int32 nCount = ( nEventMask & LUA_MASKCOUNT ) ? (int32)m_nHookCount : 0;
+
+		// lua_sethook会重新开始计数，调试器在每次call/ret都会调用这里，
+		// 钩子没变时不能重设，否则计数事件永远等不到
+		if( lua_gethook( pState ) == funHook && lua_gethookmask( pState ) == nEventMask &&
+			( !nCount || lua_gethookcount( pState ) == nCount ) )
+			return;
+		lua_sethook( pState, funHook, nEventMask, nCount );
+	}
+
+	void CScriptLua::SetDebugLine()
+	{
+		// 调试用，记录最近执行过的行，和调试器、采样共用同一个钩子
+		m_bDebugLine = true;
+		for( size_t i = 0; i < m_vecLuaState.size(); i++ )
+			RefreshHook( m_vecLuaState[i] );
+	}
+
+	void CScriptLua::RefreshHook( lua_State* pState )
+	{
+		SetHookMask( pState, lua_gethookmask( pState ) );
+	}
+
+	void CScriptLua::UpdateHookCount()
+	{
+		uint32 nCount = m_nProfileInterval;
+		if( m_bBudgetHook && m_bBudgetExceeded )
+			nCount = 1;
+		else if( m_bBudgetHook && ( !nCount || nCount > eBudgetHookCount ) )
+			nCount = eBudgetHookCount;
+		m_nHookCount = nCount;
+		for( size_t i = 0; i < m_vecLuaState.size(); i++ )
+			RefreshHook( m_vecLuaState[i] );
+	}
+
+	//=========================================================================
+	// 采样分析
+	//=========================================================================
+	void CScriptLua::SampleStack( lua_State* pState )
+	{
+		lua_Debug Frame;
+		int32 nDepth = 0;
+		while( lua_getstack( pState, nDepth, &Frame ) )
+			nDepth++;
+		if( !nDepth )
+			return;
+
+		// folded stack要求根在前，帧之间以';'分隔
+		char szFrame[256];
+		m_strProfileStack.clear();
+		for( int32 nLevel = nDepth - 1; nLevel >= 0; nLevel-- )
+		{
+			lua_getstack( pState, nLevel, &Frame );
+			lua_getinfo( pState, "Snf", &Frame );
+			if( lua_tocfunction( pState, -1 ) == &CScriptLua::CallByLua )
+			{
+				lua_getupvalue( pState, -1, 1 );
+				auto pCallBase = (const CCallInfo*)lua_touserdata( pState, -1 );
+				lua_pop( pState, 1 );
+				sprintf( szFrame, "[C++]%.200s", pCallBase->GetFunctionName().c_str() );
+			}
+			else if( Frame.what[0] == 'm' )
+				sprintf( szFrame, "main@%s", Frame.short_src );
+			else
+				sprintf( szFrame, "%.128s@%s:%d", Frame.name ? Frame.name : "?", 
+					Frame.short_src, Frame.linedefined );
+			lua_pop( pState, 1 );
+
+			if( !m_strProfileStack.empty() )
+				m_strProfileStack.push_back( ';' );
+			for( const char* c = szFrame; *c; c++ )
+				m_strProfileStack.push_back( *c == ';' || *c == ' ' ? '_' : *c );
+		}
+		m_mapProfileStack[m_strProfileStack]++;
+	}
+
+	bool CScriptLua::StartProfile( uint32 nInstructionInterval )
+	{
+		if( !nInstructionInterval )
+			return false;
+		m_nProfileInterval = nInstructionInterval;
+		m_nProfileTick = 0;
+		m_mapProfileStack.clear();
+		UpdateHookCount();
+		return true;
+	}
+
+	void CScriptLua::StopProfile()
+	{
+		if( !m_nProfileInterval )
+			return;
+		// 其它协程上的count事件在下一次触发时自行更新
+		m_nProfileInterval = 0;
+		UpdateHookCount();
+	}
+
+	bool CScriptLua::SaveProfile( const char* szFileName )
+	{
+		FILE* fp = fopen( szFileName, "wb" );
+		if( !fp )
+			return false;
+		for( auto it = m_mapProfileStack.begin(); it != m_mapProfileStack.end(); ++it )
+			fprintf( fp, "%s %u\n", it->first.c_str(), it->second );
+		fclose( fp );
+		return true;
+	}
 
     bool CScriptLua::RunBuffer( const void* pBuffer, size_t nSize, const char* szFileName )
 	{
@@ -1264,9 +1652,23 @@ namespace XS
 		sprintf( szBuf, "@%s", szFileName );
 		SReadContext Context = { pBuffer, nSize };
 
-		if( GetGlobObject( pL, szFileName ) ||
-			( !lua_load( pL, &SReadContext::Read, &Context, szBuf ) && 
-				SetGlobObject( pL, szFileName ) ) )
+		bool bLoaded = GetGlobObject( pL, szFileName );
+		if( !bLoaded && !lua_load( pL, &SReadContext::Read, &Context, szBuf ) )
+		{
+			SetGlobObject( pL, szFileName );
+			if( !strncmp( szFileName, s_CacheTruckPrefix.c_str(), s_CacheTruckPrefix.size() ) )
+			{
+				lua_pushlightuserdata( pL, CScriptLua::ms_pChunkCacheKey );
+				lua_rawget( pL, LUA_REGISTRYINDEX );
+				lua_pushstring( pL, szFileName );
+				lua_pushvalue( pL, -3 );
+				lua_rawset( pL, -3 );
+				lua_pop( pL, 1 );
+			}
+			bLoaded = true;
+		}
+
+		if( bLoaded )
 		{
 			if( m_bPreventExeInRunBuffer )
 				return true;
@@ -1288,6 +1690,21 @@ namespace XS
 
 		return false;
 	}
+
+	void CScriptLua::ReleaseChunk( const char* szChunkName )
+	{
+		lua_State* pL = GetLuaState();
+		lua_pushlightuserdata( pL, CScriptLua::ms_pChunkCacheKey );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		lua_pushstring( pL, szChunkName );
+		lua_pushnil( pL );
+		lua_rawset( pL, -3 );
+		lua_pop( pL, 1 );
+
+		lua_pushnil( pL );
+		SetGlobObject( pL, szChunkName );
+		lua_pop( pL, 1 );
+	}
 	
 	bool CScriptLua::RunFunction( const STypeInfoArray& aryTypeInfo, void* pResultBuf, const char* szFunction, void** aryArg )
 	{
@@ -1325,6 +1742,733 @@ namespace XS
 		return true;
 	}
 
+	//=========================================================================
+	// 只读共享数据
+	//=========================================================================
+	static void PushSharedData( lua_State* pL, const CSharedData* pData );
+
+	static const CSharedData* GetSharedData( lua_State* pL, int32 nStkId )
+	{
+		return *(const CSharedData**)lua_touserdata( pL, nStkId );
+	}
+
+	static int32 SharedIndex( lua_State* pL )
+	{
+		const CSharedData* pData = GetSharedData( pL, 1 );
+		const CSharedData* pItem = NULL;
+		if( pData->GetType() == CSharedData::eType_Array && lua_type( pL, 2 ) == LUA_TNUMBER )
+		{
+			// 只接受1到元素个数之间的整数下标，其他的返回nil
+			double fIndex = lua_tonumber( pL, 2 );
+			if( fIndex >= 1 && fIndex <= pData->GetCount() && fIndex == (double)(uint32)fIndex )
+				pItem = pData->GetItem( (uint32)fIndex - 1 );
+		}
+		else if( pData->GetType() == CSharedData::eType_Map && lua_type( pL, 2 ) == LUA_TSTRING )
+			pItem = pData->Find( lua_tostring( pL, 2 ) );
+		PushSharedData( pL, pItem );
+		return 1;
+	}
+
+	static int32 SharedNewIndex( lua_State* pL )
+	{
+		return luaL_error( pL, "shared data is read only" );
+	}
+
+	static int32 SharedLen( lua_State* pL )
+	{
+		lua_pushnumber( pL, GetSharedData( pL, 1 )->GetCount() );
+		return 1;
+	}
+
+	static int32 SharedNext( lua_State* pL )
+	{
+		const CSharedData* pData = GetSharedData( pL, 1 );
+		uint32 nIndex = 0;
+		if( pData->GetType() == CSharedData::eType_Array )
+		{
+			if( !lua_isnil( pL, 2 ) )
+				nIndex = (uint32)lua_tonumber( pL, 2 );
+			if( nIndex >= pData->GetCount() )
+				return 0;
+			lua_pushnumber( pL, nIndex + 1 );
+		}
+		else
+		{
+			if( !lua_isnil( pL, 2 ) )
+				nIndex = (uint32)( pData->FindIndex( lua_tostring( pL, 2 ) ) + 1 );
+			if( nIndex >= pData->GetCount() )
+				return 0;
+			lua_pushstring( pL, pData->GetKey( nIndex ) );
+		}
+		PushSharedData( pL, pData->GetItem( nIndex ) );
+		return 2;
+	}
+
+	// for k, v in shared() do ... end
+	static int32 SharedCall( lua_State* pL )
+	{
+		lua_pushcfunction( pL, &SharedNext );
+		lua_pushvalue( pL, 1 );
+		lua_pushnil( pL );
+		return 3;
+	}
+
+	static void PushSharedData( lua_State* pL, const CSharedData* pData )
+	{
+		if( !pData )
+			return lua_pushnil( pL );
+		switch( pData->GetType() )
+		{
+		case CSharedData::eType_Bool:
+			return lua_pushboolean( pL, pData->GetBool() );
+		case CSharedData::eType_Number:
+			return lua_pushnumber( pL, pData->GetNumber() );
+		case CSharedData::eType_String:
+			return lua_pushlstring( pL, pData->GetString(), pData->GetStringSize() );
+		case CSharedData::eType_Array:
+		case CSharedData::eType_Map:
+			break;
+		default:
+			return lua_pushnil( pL );
+		}
+
+		lua_pushlightuserdata( pL, CScriptLua::ms_pSharedDataKey );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		lua_pushlightuserdata( pL, (void*)pData );
+		lua_rawget( pL, -2 );
+		if( !lua_isnil( pL, -1 ) )
+		{
+			lua_remove( pL, -2 );
+			return;
+		}
+		lua_pop( pL, 1 );
+
+		*(const CSharedData**)lua_newuserdata( pL, sizeof( pData ) ) = pData;
+		lua_pushlightuserdata( pL, CScriptLua::ms_pSharedMetaKey );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		lua_setmetatable( pL, -2 );
+		lua_pushlightuserdata( pL, (void*)pData );
+		lua_pushvalue( pL, -2 );
+		lua_rawset( pL, -4 );
+		lua_remove( pL, -2 );
+	}
+
+	bool CScriptLua::PublishSharedData( const char* szName, const CSharedData* pData )
+	{
+		if( !szName || !pData || !pData->IsFrozen() )
+			return false;
+
+		lua_State* pL = GetLuaState();
+		lua_pushlightuserdata( pL, ms_pSharedMetaKey );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		bool bNewMeta = lua_isnil( pL, -1 );
+		lua_pop( pL, 1 );
+		if( bNewMeta )
+		{
+			lua_pushlightuserdata( pL, ms_pSharedMetaKey );
+			lua_newtable( pL );
+			lua_pushcfunction( pL, &SharedIndex );
+			lua_setfield( pL, -2, "__index" );
+			lua_pushcfunction( pL, &SharedNewIndex );
+			lua_setfield( pL, -2, "__newindex" );
+			lua_pushcfunction( pL, &SharedLen );
+			lua_setfield( pL, -2, "__len" );
+			lua_pushcfunction( pL, &SharedCall );
+			lua_setfield( pL, -2, "__call" );
+			lua_pushboolean( pL, 0 );
+			lua_setfield( pL, -2, "__metatable" );
+			lua_rawset( pL, LUA_REGISTRYINDEX );
+		}
+
+		PushSharedData( pL, pData );
+		lua_setglobal( pL, szName );
+		return true;
+	}
+
+	//=========================================================================
+	// 二进制序列化，格式见CScriptSerial.h
+	//=========================================================================
+	// nVisited是table到序号的映射，nCount是已经写出的table数量
+	static bool SerializeLuaValue( lua_State* pL, int32 nStkId, CSerialWriter& Writer, 
+		int32 nVisited, uint32& nCount, uint32 nDepth )
+	{
+		switch( lua_type( pL, nStkId ) )
+		{
+		case LUA_TNIL:
+			Writer.WriteTag( eSerial_Nil );
+			return true;
+		case LUA_TBOOLEAN:
+			Writer.WriteTag( lua_toboolean( pL, nStkId ) ? eSerial_True : eSerial_False );
+			return true;
+		case LUA_TNUMBER:
+			Writer.WriteNumber( lua_tonumber( pL, nStkId ) );
+			return true;
+		case LUA_TSTRING:
+		{
+			size_t nSize = 0;
+			const char* szValue = lua_tolstring( pL, nStkId, &nSize );
+			Writer.WriteString( szValue, nSize );
+			return true;
+		}
+		case LUA_TTABLE:
+			break;
+		case LUA_TUSERDATA:
+		{
+			int64 nValue;
+			bool bUnsigned;
+			if( !GetBoxedInt64( pL, nStkId, nValue, bUnsigned ) )
+				return false;
+			Writer.WriteInt( nValue );
+			return true;
+		}
+		default:
+			return false;
+		}
+
+		if( nDepth >= eSerial_MaxDepth || !lua_checkstack( pL, 4 ) )
+			return false;
+		if( nStkId < 0 )
+			nStkId = lua_gettop( pL ) + nStkId + 1;
+
+		// 写过的table只写引用，共享的table和循环引用都能还原
+		lua_pushvalue( pL, nStkId );
+		lua_rawget( pL, nVisited );
+		if( !lua_isnil( pL, -1 ) )
+		{
+			Writer.WriteRef( (uint32)lua_tonumber( pL, -1 ) );
+			lua_pop( pL, 1 );
+			return true;
+		}
+		lua_pop( pL, 1 );
+
+		// c++对象的元表是类表，类表带有_info
+		if( lua_getmetatable( pL, nStkId ) )
+		{
+			lua_getfield( pL, -1, "_info" );
+			bool bCppObject = !lua_isnil( pL, -1 );
+			lua_pop( pL, 2 );
+			if( bCppObject )
+				return false;
+		}
+
+		lua_pushvalue( pL, nStkId );
+		lua_pushnumber( pL, nCount++ );
+		lua_rawset( pL, nVisited );
+
+		// 键恰好是1~n时按数组编码
+		uint32 nSize = 0;
+		uint32 nLen = (uint32)lua_objlen( pL, nStkId );
+		bool bArray = true;
+		for( lua_pushnil( pL ); lua_next( pL, nStkId ); lua_pop( pL, 1 ) )
+		{
+			nSize++;
+			if( !bArray )
+				continue;
+			double fKey = lua_type( pL, -2 ) == LUA_TNUMBER ? lua_tonumber( pL, -2 ) : 0;
+			bArray = fKey >= 1 && fKey <= nLen && fKey == (double)(uint32)fKey;
+		}
+
+		if( bArray && nSize == nLen )
+		{
+			Writer.WriteContainer( eSerial_Array, nSize );
+			for( uint32 i = 1; i <= nSize; i++ )
+			{
+				lua_rawgeti( pL, nStkId, i );
+				bool bSucceeded = SerializeLuaValue( pL, -1, Writer, nVisited, nCount, nDepth + 1 );
+				lua_pop( pL, 1 );
+				if( !bSucceeded )
+					return false;
+			}
+			return true;
+		}
+
+		Writer.WriteContainer( eSerial_Map, nSize );
+		for( lua_pushnil( pL ); lua_next( pL, nStkId ); lua_pop( pL, 1 ) )
+		{
+			if( SerializeLuaValue( pL, -2, Writer, nVisited, nCount, nDepth + 1 ) &&
+				SerializeLuaValue( pL, -1, Writer, nVisited, nCount, nDepth + 1 ) )
+				continue;
+			lua_pop( pL, 2 );
+			return false;
+		}
+		return true;
+	}
+
+	// nLoaded按出现顺序记录已经创建的table，供引用查找
+	static bool DeserializeLuaValue( lua_State* pL, CSerialReader& Reader, 
+		int32 nLoaded, uint32& nCount, uint32 nDepth )
+	{
+		ESerialTag eTag;
+		if( nDepth >= eSerial_MaxDepth || !Reader.ReadTag( eTag ) || !lua_checkstack( pL, 3 ) )
+			return false;
+
+		double fValue;
+		const char* szValue;
+		uint32 nSize;
+		switch( eTag )
+		{
+		case eSerial_Nil:
+			lua_pushnil( pL );
+			return true;
+		case eSerial_False:
+		case eSerial_True:
+			lua_pushboolean( pL, eTag == eSerial_True );
+			return true;
+		case eSerial_Int:
+		{
+			int64 nValue;
+			if( !Reader.ReadInt( nValue ) )
+				return false;
+			PushInt64ToLua( pL, nValue, false );
+			return true;
+		}
+		case eSerial_Double:
+			if( !Reader.ReadDouble( fValue ) )
+				return false;
+			lua_pushnumber( pL, fValue );
+			return true;
+		case eSerial_String:
+			if( !Reader.ReadString( szValue, nSize ) )
+				return false;
+			lua_pushlstring( pL, szValue, nSize );
+			return true;
+		case eSerial_Array:
+			if( !Reader.ReadCount( nSize ) )
+				return false;
+			lua_createtable( pL, nSize, 0 );
+			lua_pushvalue( pL, -1 );
+			lua_rawseti( pL, nLoaded, ++nCount );
+			for( uint32 i = 1; i <= nSize; i++ )
+			{
+				if( !DeserializeLuaValue( pL, Reader, nLoaded, nCount, nDepth + 1 ) )
+					return false;
+				lua_rawseti( pL, -2, i );
+			}
+			return true;
+		case eSerial_Map:
+			if( !Reader.ReadCount( nSize ) )
+				return false;
+			lua_createtable( pL, 0, nSize );
+			lua_pushvalue( pL, -1 );
+			lua_rawseti( pL, nLoaded, ++nCount );
+			for( uint32 i = 0; i < nSize; i++ )
+			{
+				if( !DeserializeLuaValue( pL, Reader, nLoaded, nCount, nDepth + 1 ) ||
+					!DeserializeLuaValue( pL, Reader, nLoaded, nCount, nDepth + 1 ) )
+					return false;
+				if( lua_isnil( pL, -2 ) )
+					return false;
+				lua_rawset( pL, -3 );
+			}
+			return true;
+		case eSerial_Ref:
+			if( !Reader.ReadRef( nSize ) || nSize >= nCount )
+				return false;
+			lua_rawgeti( pL, nLoaded, nSize + 1 );
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static size_t DeserializeLuaBuffer( lua_State* pL, const void* pBuffer, size_t nSize )
+	{
+		// 返回读取的字节数，失败返回0
+		int32 nTop = lua_gettop( pL );
+		uint32 nCount = 0;
+		lua_newtable( pL );
+		CSerialReader Reader( pBuffer, nSize );
+		if( Reader.ReadVersion() && DeserializeLuaValue( pL, Reader, nTop + 1, nCount, 0 ) )
+		{
+			lua_remove( pL, nTop + 1 );
+			return Reader.GetReadSize( pBuffer );
+		}
+		lua_settop( pL, nTop );
+		return 0;
+	}
+
+	static bool SerializeLuaBuffer( lua_State* pL, int32 nStkId, std::string& strBuffer )
+	{
+		size_t nOrgSize = strBuffer.size();
+		uint32 nCount = 0;
+		if( nStkId < 0 )
+			nStkId = lua_gettop( pL ) + nStkId + 1;
+		lua_newtable( pL );
+		CSerialWriter Writer( strBuffer );
+		bool bSucceeded = SerializeLuaValue( pL, nStkId, Writer, lua_gettop( pL ), nCount, 0 );
+		lua_pop( pL, 1 );
+		if( !bSucceeded )
+			strBuffer.resize( nOrgSize );
+		return bSucceeded;
+	}
+
+	int32 CScriptLua::Serialize( lua_State* pL )
+	{
+		// Serialize( value [, stream] )，写入stream的当前位置，没有stream时新建一个
+		luaL_checkany( pL, 1 );
+		lua_settop( pL, 2 );
+		if( lua_isnil( pL, 2 ) )
+		{
+			lua_pop( pL, 1 );
+			NewBufferStreamInLua( pL );
+		}
+		luaL_checktype( pL, 2, LUA_TTABLE );
+
+		std::string strBuffer;
+		if( !SerializeLuaBuffer( pL, 1, strBuffer ) )
+			return luaL_error( pL, "value can not be serialized" );
+		WriteBufferStream( pL, 2, strBuffer.c_str(), (uint32)strBuffer.size() );
+		return 1;
+	}
+
+	int32 CScriptLua::Deserialize( lua_State* pL )
+	{
+		// Deserialize( stream )从当前位置读取一个值并前移，Deserialize( string )读取整个字符串
+		if( lua_type( pL, 1 ) == LUA_TTABLE )
+		{
+			uint32 nSize = 0;
+			const void* pBuffer = ReadBufferStream( pL, 1, nSize );
+			size_t nReadSize = pBuffer ? DeserializeLuaBuffer( pL, pBuffer, nSize ) : 0;
+			if( !nReadSize )
+				return luaL_error( pL, "invalid serialized data" );
+			SkipBufferStream( pL, 1, (uint32)nReadSize );
+			return 1;
+		}
+
+		size_t nSize = 0;
+		const char* szBuffer = luaL_checklstring( pL, 1, &nSize );
+		if( DeserializeLuaBuffer( pL, szBuffer, nSize ) != nSize )
+			return luaL_error( pL, "invalid serialized data" );
+		return 1;
+	}
+
+	bool CScriptLua::SerializeGlobal( const char* szName, std::string& strBuffer )
+	{
+		lua_State* pL = GetLuaState();
+		lua_getglobal( pL, szName );
+		bool bSucceeded = SerializeLuaBuffer( pL, -1, strBuffer );
+		lua_pop( pL, 1 );
+		return bSucceeded;
+	}
+
+	bool CScriptLua::DeserializeGlobal( const char* szName, const void* pBuffer, size_t nSize )
+	{
+		lua_State* pL = GetLuaState();
+		if( DeserializeLuaBuffer( pL, pBuffer, nSize ) != nSize )
+			return false;
+		lua_setglobal( pL, szName );
+		return true;
+	}
+
+	//=========================================================================
+	// 值类型与table整体转换，按注册的成员逐个调用存取函数
+	//=========================================================================
+	static void PushFieldsToLua( lua_State* pL, CScriptLua* pScript, 
+		const CClassInfo* pInfo, char* pObj )
+	{
+		const CClassInfo::CFieldArray& vecField = pInfo->GetFields();
+		char* pDataBuf = (char*)alloca( pInfo->GetFieldBufferSize() );
+		luaL_checkstack( pL, 3, "ToTable" );
+		lua_createtable( pL, 0, (int32)vecField.size() );
+		for( size_t i = 0; i < vecField.size(); i++ )
+		{
+			const CMemberInfo* pMember = vecField[i].m_pMember;
+			if( !pMember->GetFunWrap() )
+				continue;
+			DataType nType = pMember->GetResultType();
+			char* pThis = pObj + vecField[i].m_nBaseOff;
+			if( const CClassInfo* pMemberClass = CClassInfo::GetConvertibleClass( nType ) )
+			{
+				PushFieldsToLua( pL, pScript, pMemberClass, pThis + pMember->GetOffset() );
+			}
+			else
+			{
+				void* aryArg[2] = { &pThis, NULL };
+				pMember->Call( pDataBuf, aryArg, *pScript );
+				GetLuaTypeBase( nType )->PushToVM( nType, pL, pDataBuf );
+				if( IsValueClass( nType ) )
+					( (const CClassInfo*)( ( nType >> 1 ) << 1 ) )->Destruct( pScript, pDataBuf );
+			}
+			lua_setfield( pL, -2, pMember->GetFunctionName().c_str() );
+		}
+	}
+
+	static void GetFieldsFromLua( lua_State* pL, CScriptLua* pScript, 
+		const CClassInfo* pInfo, char* pObj, int32 nTable )
+	{
+		const CClassInfo::CFieldArray& vecField = pInfo->GetFields();
+		char* pDataBuf = (char*)alloca( pInfo->GetFieldBufferSize() );
+		luaL_checkstack( pL, 2, "FromTable" );
+		for( size_t i = 0; i < vecField.size(); i++ )
+		{
+			const CMemberInfo* pMember = vecField[i].m_pMember;
+			if( !pMember->GetFunSet() )
+				continue;
+
+			// 表里没有的字段保持原值
+			lua_getfield( pL, nTable, pMember->GetFunctionName().c_str() );
+			if( lua_isnil( pL, -1 ) )
+			{
+				lua_pop( pL, 1 );
+				continue;
+			}
+
+			DataType nType = pMember->GetResultType();
+			char* pThis = pObj + vecField[i].m_nBaseOff;
+			const CClassInfo* pMemberClass = CClassInfo::GetConvertibleClass( nType );
+			if( pMemberClass && lua_istable( pL, -1 ) && !lua_getmetatable( pL, -1 ) )
+			{
+				GetFieldsFromLua( pL, pScript, pMemberClass, 
+					pThis + pMember->GetOffset(), lua_gettop( pL ) );
+			}
+			else
+			{
+				if( pMemberClass && lua_istable( pL, -1 ) )
+					lua_pop( pL, 1 );
+				GetLuaTypeBase( nType )->GetFromVM( nType, pL, pDataBuf, -1 );
+				void* aryArg[2] = { &pThis, IsValueClass( nType ) ? *(void**)pDataBuf : pDataBuf };
+				pMember->Call( NULL, aryArg, *pScript );
+			}
+			lua_pop( pL, 1 );
+		}
+	}
+
+	int32 CScriptLua::ToTable( lua_State* pL )
+	{
+		auto pInfo = (const CClassInfo*)lua_touserdata( pL, lua_upvalueindex( 1 ) );
+		char* pObj = NULL;
+		CLuaObject::GetInst().GetFromVM( ( (DataType)pInfo )|1, pL, (char*)&pObj, 1 );
+		if( !pObj )
+			return luaL_error( pL, "ToTable: invalid %s object", pInfo->GetClassName().c_str() );
+
+		CScriptLua* pScript = GetScript( pL );
+		pScript->PushLuaState( pL );
+		PushFieldsToLua( pL, pScript, pInfo, pObj );
+		pScript->PopLuaState();
+		return 1;
+	}
+
+	int32 CScriptLua::FromTable( lua_State* pL )
+	{
+		auto pInfo = (const CClassInfo*)lua_touserdata( pL, lua_upvalueindex( 1 ) );
+		char* pObj = NULL;
+		CLuaObject::GetInst().GetFromVM( ( (DataType)pInfo )|1, pL, (char*)&pObj, 1 );
+		if( !pObj )
+			return luaL_error( pL, "FromTable: invalid %s object", pInfo->GetClassName().c_str() );
+		luaL_checktype( pL, 2, LUA_TTABLE );
+
+		CScriptLua* pScript = GetScript( pL );
+		pScript->PushLuaState( pL );
+		GetFieldsFromLua( pL, pScript, pInfo, pObj, 2 );
+		pScript->PopLuaState();
+		lua_settop( pL, 1 );
+		return 1;
+	}
+
+	//=========================================================================
+	// 执行预算
+	//=========================================================================
+	void CScriptLua::BeginBudget()
+	{
+		m_bBudgetHook = true;
+		UpdateHookCount();
+	}
+
+	void CScriptLua::EndBudget()
+	{
+		m_bBudgetHook = false;
+		UpdateHookCount();
+	}
+
+	//=========================================================================
+	// 热更新
+	//=========================================================================
+	void CScriptLua::BeginReload()
+	{
+		lua_State* pL = GetLuaState();
+		lua_getglobal( pL, "__reload_begin" );
+		if( lua_pcall( pL, 0, 0, 0 ) )
+			lua_pop( pL, 1 );
+	}
+
+	void CScriptLua::EndReload()
+	{
+		lua_State* pL = GetLuaState();
+		lua_getglobal( pL, "__reload_end" );
+		if( lua_pcall( pL, 0, 0, 0 ) )
+			lua_pop( pL, 1 );
+	}
+
+	bool CScriptLua::ReloadFile( const char* szFileName )
+	{
+		// require加载的模块要清掉package.loaded，重新require
+		lua_State* pL = GetLuaState();
+		int32 nTop = lua_gettop( pL );
+		lua_getglobal( pL, "package" );
+		lua_getfield( pL, -1, "loaded" );
+		lua_getfield( pL, -1, szFileName );
+		if( lua_isnil( pL, -1 ) )
+		{
+			lua_settop( pL, nTop );
+			return RunFile( szFileName );
+		}
+
+		lua_pop( pL, 1 );
+		lua_pushnil( pL );
+		lua_setfield( pL, -2, szFileName );
+		lua_settop( pL, nTop );
+
+		lua_pushlightuserdata( pL, ms_pErrorHandlerKey );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		lua_getglobal( pL, "require" );
+		lua_pushstring( pL, szFileName );
+		bool bResult = !lua_pcall( pL, 1, 0, nTop + 1 );
+		lua_settop( pL, nTop );
+		return bResult;
+	}
+
+	//=========================================================================
+	// 协程调度
+	//=========================================================================
+	bool CScriptLua::RunCoroutine( uint32 nID, lua_State* pThread, int32 nArgCount )
+	{
+		PushLuaState( pThread );
+		int32 nResult;
+		{
+			// 协程和RunFunction一样受执行预算约束
+			CBudgetGuard Guard( this );
+			RefreshHook( pThread );
+			nResult = lua_resume( pThread, nArgCount );
+		}
+		PopLuaState();
+
+		// 协程里的C++函数请求挂起后没有走到yield，不能留给别的调用
+		if( m_pYieldState == pThread )
+			m_pYieldState = NULL;
+
+		if( nResult == LUA_YIELD )
+		{
+			// yield的返回值不需要，恢复前清掉
+			lua_settop( pThread, 0 );
+			return true;
+		}
+
+		if( nResult )
+		{
+			// 出错时协程的调用栈还在，可以直接交给调试器
+			const char* szWhat = lua_tostring( pThread, -1 );
+			CDebugLua* pDebugger = static_cast<CDebugLua*>( GetDebugger() );
+			pDebugger->SetCurState( pThread );
+			pDebugger->Error( szWhat ? szWhat : "unknown error", true );
+		}
+
+		KillCoroutine( nID );
+		return nResult == 0;
+	}
+
+	uint32 CScriptLua::StartCoroutine( const STypeInfoArray& aryTypeInfo, const char* szFunction, void** aryArg )
+	{
+		lua_State* pL = GetLuaState();
+		int32 nTop = lua_gettop( pL );
+
+		const char* szFun = "return %s";
+		char szFuncBuf[256];
+		sprintf( szFuncBuf, szFun, szFunction );
+		if( GetGlobObject( pL, szFuncBuf ) || ( !luaL_loadstring( pL, szFuncBuf ) && SetGlobObject( pL, szFuncBuf ) ) )
+			lua_pcall( pL, 0, LUA_MULTRET, 0 );
+		if( !lua_isfunction( pL, -1 ) )
+		{
+			lua_settop( pL, nTop );
+			return 0;
+		}
+
+		if( !++m_nCoroutineID )
+			++m_nCoroutineID;
+		uint32 nID = m_nCoroutineID;
+		lua_State* pThread = lua_newthread( pL );
+		lua_pushlightuserdata( pL, ms_pCoroutineKey );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		lua_pushnumber( pL, nID );
+		lua_pushvalue( pL, -3 );
+		lua_rawset( pL, -3 );
+		lua_pop( pL, 2 );
+		lua_xmove( pL, pThread, 1 );
+		lua_settop( pL, nTop );
+		m_mapCoroutine[nID] = pThread;
+		m_mapCoroutineID[pThread] = nID;
+
+		uint32 nParamCount = aryTypeInfo.nSize - 1;
+		for( uint32 nArgIndex = 0; nArgIndex < nParamCount; nArgIndex++ )
+		{
+			DataType nType = ToDataType( aryTypeInfo.aryInfo[nArgIndex] );
+			CLuaTypeBase* pParamType = GetLuaTypeBase( nType );
+			pParamType->PushToVM( nType, pThread, (char*)aryArg[nArgIndex] );
+		}
+
+		RunCoroutine( nID, pThread, nParamCount );
+		return nID;
+	}
+
+	bool CScriptLua::ResumeCoroutine( const STypeInfoArray& aryTypeInfo, uint32 nID, void** aryArg )
+	{
+		auto it = m_mapCoroutine.find( nID );
+		if( it == m_mapCoroutine.end() )
+			return false;
+		lua_State* pThread = it->second;
+		if( lua_status( pThread ) != LUA_YIELD )
+			return false;
+
+		uint32 nParamCount = aryTypeInfo.nSize - 1;
+		for( uint32 nArgIndex = 0; nArgIndex < nParamCount; nArgIndex++ )
+		{
+			DataType nType = ToDataType( aryTypeInfo.aryInfo[nArgIndex] );
+			CLuaTypeBase* pParamType = GetLuaTypeBase( nType );
+			pParamType->PushToVM( nType, pThread, (char*)aryArg[nArgIndex] );
+		}
+		return RunCoroutine( nID, pThread, nParamCount );
+	}
+
+	bool CScriptLua::YieldCoroutine()
+	{
+		// 只能挂起StartCoroutine创建的协程，并且不能跨越pcall等C调用边界
+		lua_State* pL = GetLuaState();
+		if( m_mapCoroutineID.find( pL ) == m_mapCoroutineID.end() || 
+			pL->nCcalls > pL->baseCcalls )
+			return false;
+		m_pYieldState = pL;
+		return true;
+	}
+
+	bool CScriptLua::KillCoroutine( uint32 nID )
+	{
+		auto it = m_mapCoroutine.find( nID );
+		if( it == m_mapCoroutine.end() )
+			return false;
+
+		// 正在运行的协程不能释放
+		lua_State* pThread = it->second;
+		for( size_t i = 0; i < m_vecLuaState.size(); i++ )
+			if( m_vecLuaState[i] == pThread )
+				return false;
+
+		lua_State* pL = GetLuaState();
+		lua_pushlightuserdata( pL, ms_pCoroutineKey );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		lua_pushnumber( pL, nID );
+		lua_pushnil( pL );
+		lua_rawset( pL, -3 );
+		lua_pop( pL, 1 );
+		m_mapCoroutineID.erase( pThread );
+		m_mapCoroutine.erase( it );
+		return true;
+	}
+
+	uint32 CScriptLua::GetCurCoroutine()
+	{
+		auto it = m_mapCoroutineID.find( GetLuaState() );
+		return it == m_mapCoroutineID.end() ? 0 : it->second;
+	}
+
     void CScriptLua::UnlinkCppObjFromScript( void* pObj )
 	{
 		lua_State* pL = GetLuaState();
@@ -1343,6 +2487,7 @@ namespace XS
 			return;
 		}
 
+		BindObjectStat( pL, nTop + 2, NULL );
 		lua_getmetatable( pL, -1 );
 		if( !lua_isnil( pL, -1 ) )
 		{
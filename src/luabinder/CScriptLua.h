@@ -17,10 +17,15 @@ namespace XS
     class CDebugLua;
 	class CScriptLua : public CScriptBase
 	{
-		enum { eMemoryStep = 8, eMaxManageMemoryCount = 8 };
+		enum { eMemoryStep = 8, eMaxManageMemoryCount = 8, eBudgetHookCount = 10000 };
 		struct SMemoryBlock	{ SMemoryBlock* m_pNext; };
+		typedef std::map<const_string, const CClassInfo*> CClassNameMap;
+		typedef std::map<std::string, uint32> CProfileStackMap;
+		typedef std::map<uint32, lua_State*> CCoroutineMap;
+		typedef std::map<lua_State*, uint32> CCoroutineIDMap;
 
 		std::vector<lua_State*>	m_vecLuaState;
+		CClassNameMap			m_mapClassName;
 		std::wstring			m_szTempUcs2;
 		std::string				m_szTempUtf8;
 
@@ -28,6 +33,19 @@ namespace XS
 		SMemoryBlock*			m_aryBlock[eMaxManageMemoryCount];
 		bool					m_bPreventExeInRunBuffer;
 
+		uint32					m_nHookCount;
+		uint32					m_nProfileInterval;
+		uint32					m_nProfileTick;
+		CProfileStackMap		m_mapProfileStack;
+		std::string				m_strProfileStack;
+
+		CCoroutineMap			m_mapCoroutine;
+		CCoroutineIDMap			m_mapCoroutineID;
+		uint32					m_nCoroutineID;
+		lua_State*				m_pYieldState;
+		bool					m_bBudgetHook;
+		bool					m_bDebugLine;
+
         //==============================================================================
         // aux function
         //==============================================================================
@@ -44,11 +62,23 @@ namespace XS
 		static void*			Realloc( void* pContex, void* pPreBuff, size_t nOldSize, size_t nNewSize );	
 		static int32			Print( lua_State* pL );
 		static int32			ToString( lua_State* pL );
-
-		static void				DebugHookProc( lua_State *pState, lua_Debug* pDebug );
+		static int32			LazyBindClass( lua_State* pL );
+		static int32			Serialize( lua_State* pL );
+		static int32			Deserialize( lua_State* pL );
+		static int32			ToTable( lua_State* pL );
+		static int32			FromTable( lua_State* pL );
+
+		static void				HookProc( lua_State *pState, lua_Debug* pDebug );
+		static int32			BoundStatGC( lua_State* pL );
+		static void				BindObjectStat( lua_State* pL, int32 nObj, const CClassInfo* pInfo );
 		static bool				GetGlobObject( lua_State* pL, const char* szKey );
 		static bool				SetGlobObject( lua_State* pL, const char* szKey );
 
+		void					SetHookMask( lua_State* pState, int32 nEventMask );
+		void					RefreshHook( lua_State* pState );
+		void					UpdateHookCount();
+		void					SampleStack( lua_State* pState );
+		bool					RunCoroutine( uint32 nID, lua_State* pThread, int32 nArgCount );
 		void					BuildRegisterInfo();
         void					AddLoader();
 		void					IO_Replace();
@@ -58,6 +88,11 @@ namespace XS
 
 		virtual bool			CallVM( const CCallbackInfo* pCallBase, void* pRetBuf, void** pArgArray );
 		virtual void			DestrucVM( const CCallbackInfo* pCallBase, SVirtualObj* pObject );
+		virtual void			BeginBudget();
+		virtual void			EndBudget();
+		virtual void			BeginReload();
+		virtual void			EndReload();
+		virtual bool			ReloadFile( const char* szFileName );
 
 		friend class CDebugLua;
 		friend class CLuaBuffer;
@@ -73,12 +108,20 @@ namespace XS
 		static void*			ms_pRegistScriptLuaKey;
 		static void*			ms_pErrorHandlerKey;
 		static void*			ms_pClassInfoKey;
+		static void*			ms_pChunkCacheKey;
+		static void*			ms_pCoroutineKey;
+		static void*			ms_pSharedDataKey;
+		static void*			ms_pSharedMetaKey;
+		static void*			ms_pBoundStatKey;
+		static void*			ms_pBoundMetaKey;
 
         //==============================================================================
         // common function
         //==============================================================================
-        static void*			NewLuaObj( lua_State* pL, const CClassInfo* pInfo );
+        static void*			NewLuaObj( lua_State* pL, const CClassInfo* pInfo, 
+									EObjectStat eStat = eObjStat_NewByVM );
 		static void				RegisterObject( lua_State* pL, const CClassInfo* pInfo, void* pObj, bool bGC );
+		static bool				BindClass( lua_State* pL, const CClassInfo* pInfo );
 		static void				NewUnicodeString( lua_State* pL, const wchar_t* szStr );
 		static const wchar_t*	ConvertUtf8ToUcs2( lua_State* pL, int32 nStkId );
 
@@ -87,13 +130,65 @@ namespace XS
 		void					PopLuaState();
 		void					SetDebugLine();
 
+		/**
+		 * @brief 采样分析：每执行nInstructionInterval条指令记录一次调用栈
+		 *  只有Lua指令会触发采样，在C++函数里花的时间全部算在调用它的Lua函数上
+		 *  C++函数回调Lua时，采样栈中才会出现"[C++]函数名"帧
+		 *  SaveProfile输出folded stack格式，可直接交给flamegraph工具
+		 */
+		bool					StartProfile( uint32 nInstructionInterval = 1000 );
+		void					StopProfile();
+		bool					SaveProfile( const char* szFileName );
+
+		/**
+		 * @brief 协程调度：同一个虚拟机上协作运行大量协程
+		 *  StartCoroutine以协程方式启动脚本函数，运行到第一次yield或结束，返回协程ID
+		 *  ResumeCoroutine恢复挂起的协程，参数作为yield的返回值，协程已结束时返回false
+		 *  注册的C++函数调用YieldCoroutine后，返回时挂起调用它的协程
+		 */
+		uint32					StartCoroutine( const STypeInfoArray& aryTypeInfo, const char* szFunction, void** aryArg );
+		bool					ResumeCoroutine( const STypeInfoArray& aryTypeInfo, uint32 nID, void** aryArg );
+		bool					YieldCoroutine();
+		bool					KillCoroutine( uint32 nID );
+		uint32					GetCurCoroutine();
+		uint32					GetCoroutineCount() const { return (uint32)m_mapCoroutine.size(); }
+
+		template<typename... Param>
+		uint32					StartCoroutine( const char* szFunction, Param ... p );
+		template<typename... Param>
+		bool					ResumeCoroutine( uint32 nID, Param ... p );
+
         static  CScriptLua*     GetScript( lua_State* pL );
 		virtual bool        	RunBuffer( const void* pBuffer, size_t nSize, const char* szFileName );
+		virtual void			ReleaseChunk( const char* szChunkName );
 		virtual bool        	RunFunction( const STypeInfoArray& aryTypeInfo, void* pResultBuf, const char* szFunction, void** aryArg );
+		virtual bool			PublishSharedData( const char* szName, const CSharedData* pData );
+		virtual bool			SerializeGlobal( const char* szName, std::string& strBuffer );
+		virtual bool			DeserializeGlobal( const char* szName, const void* pBuffer, size_t nSize );
 		virtual void            UnlinkCppObjFromScript( void* pObj );
 		virtual void        	GC();
 		virtual void        	GCAll();
 	};
+
+	template<typename... Param>
+	uint32 CScriptLua::StartCoroutine( const char* szFunction, Param ... p )
+	{
+		CheckDebugCmd();
+		void* aryParam[sizeof...( p ) + 1] = { &p ... };
+		static STypeInfo aryInfo[] = { GetTypeInfo<Param>()..., GetTypeInfo<void>() };
+		static STypeInfoArray TypeInfo = { aryInfo, sizeof( aryInfo )/sizeof( STypeInfo ) };
+		return StartCoroutine( TypeInfo, szFunction, aryParam );
+	}
+
+	template<typename... Param>
+	bool CScriptLua::ResumeCoroutine( uint32 nID, Param ... p )
+	{
+		CheckDebugCmd();
+		void* aryParam[sizeof...( p ) + 1] = { &p ... };
+		static STypeInfo aryInfo[] = { GetTypeInfo<Param>()..., GetTypeInfo<void>() };
+		static STypeInfoArray TypeInfo = { aryInfo, sizeof( aryInfo )/sizeof( STypeInfo ) };
+		return ResumeCoroutine( TypeInfo, nID, aryParam );
+	}
 }
 
 #endif
@@ -1,6 +1,5 @@
 ﻿#include <string>
 #include <locale>
-#include <codecvt>
 #include <algorithm>
 
 extern "C"
@@ -13,6 +12,7 @@ extern "C"
 
 #include "common/Help.h"
 #include "common/TStrStream.h"
+#include "common/UtfConvert.h"
 #include "core/CClassInfo.h"
 #include "CTypeLua.h"
 #include "CScriptLua.h"
@@ -24,6 +24,7 @@ namespace XS
 	//=====================================================================
 	static const char* s_szLuaBufferClass = "CBufferStream";
 	static const char* s_szLuaBufferInfo = "CBufferStream_hObject";
+	static const char* s_szLuaBufferOwner = "CBufferStream_hOwner";
 
 	struct SBufferInfo
 	{
@@ -60,6 +61,42 @@ namespace XS
 		}
 	}
 
+	// Pod类共用一个没有__gc的元表，存放在类表的__pod_metatable中
+	static void PushPodToLua( lua_State* pL, const CClassInfo* pClassInfo, void* pData )
+	{
+		uint32 nSize = pClassInfo->GetClassSize();
+		memcpy( lua_newuserdata( pL, nSize ), pData, nSize );
+		int32 nStkId = ToAbsStackIndex( pL, -1 );
+
+		lua_getglobal( pL, pClassInfo->GetClassName().c_str() );
+		if( lua_isnil( pL, -1 ) )
+		{
+			luaL_error( pL, "PushToVM Class:%s", pClassInfo->GetClassName().c_str() );
+			return;
+		}
+
+		lua_pushstring( pL, "__pod_metatable" );
+		lua_rawget( pL, -2 );
+		if( lua_isnil( pL, -1 ) )
+		{
+			lua_pop( pL, 1 );
+			lua_newtable( pL );
+			lua_pushstring( pL, "__index" );
+			lua_pushstring( pL, "__index" );
+			lua_rawget( pL, -4 );
+			lua_rawset( pL, -3 );
+			lua_pushstring( pL, "_info" );
+			lua_pushlightuserdata( pL, (void*)pClassInfo );
+			lua_rawset( pL, -3 );
+			lua_pushstring( pL, "__pod_metatable" );
+			lua_pushvalue( pL, -2 );
+			lua_rawset( pL, -4 );
+		}
+
+		lua_setmetatable( pL, nStkId );
+		lua_pop( pL, 1 );
+	}
+
     CLuaObject::CLuaObject()
     { 
     }
@@ -76,6 +113,27 @@ namespace XS
 		int32 nType = lua_type( pL, nStkId );
         if( nType == LUA_TNIL || nType == LUA_TNONE )
             *(void**)( pDataBuf ) = NULL;    
+		else if( nType == LUA_TUSERDATA )
+		{
+			// Pod类的值直接存放在userdata里
+			auto pClassInfo = (const CClassInfo*)( ( eType >> 1 ) << 1 );
+			const CClassInfo* pObjInfo = NULL;
+			if( lua_getmetatable( pL, nStkId ) )
+			{
+				lua_pushstring( pL, "_info" );
+				lua_rawget( pL, -2 );
+				pObjInfo = (const CClassInfo*)lua_touserdata( pL, -1 );
+				lua_pop( pL, 2 );
+			}
+
+			int32 nOffset = pObjInfo ? pObjInfo->GetBaseOffset( pClassInfo ) : -1;
+			if( nOffset < 0 )
+			{
+				luaL_error( pL, "GetFromVM error id:%d", nStkId );
+				return;
+			}
+			*(void**)( pDataBuf ) = (char*)lua_touserdata( pL, nStkId ) + nOffset;
+		}
         else
         {
 			if( !lua_istable( pL, nStkId )  )
@@ -189,15 +247,18 @@ namespace XS
 
 	void CLuaValueObject::PushToVM( DataType eType, lua_State* pL, char* pDataBuf )
 	{
+		auto pClassInfo = (const CClassInfo*)( ( eType >> 1 ) << 1 );
+		if( pClassInfo->IsPod() )
+			return PushPodToLua( pL, pClassInfo, pDataBuf );
+
 		// Table 在Lua栈顶
 		lua_newtable( pL );// Obj
 		int32 nStkId = ToAbsStackIndex( pL, -1 );
 
-		auto pClassInfo = (const CClassInfo*)( ( eType >> 1 ) << 1 );
 		lua_getglobal( pL, pClassInfo->GetClassName().c_str() );
 		lua_setmetatable( pL, nStkId );
 
-		void* pNewObj = CScriptLua::NewLuaObj( pL, pClassInfo );
+		void* pNewObj = CScriptLua::NewLuaObj( pL, pClassInfo, eObjStat_ValueCopy );
 		CScriptLua* pScriptLua = CScriptLua::GetScript( pL );
 		pScriptLua->PushLuaState( pL );
 		pClassInfo->CopyConstruct( pScriptLua, pNewObj, pDataBuf );
@@ -225,6 +286,27 @@ namespace XS
 		template<class Type>
 		static void			WriteData( lua_State* pL, Type v );
 
+		typedef void (*ReadArrayFun)( lua_State*, const tbyte*, uint32, int32, bool );
+		typedef void (*WriteArrayFun)( lua_State*, tbyte*, uint32, int32, bool );
+		struct SArrayType
+		{
+			const char*		m_szName;
+			uint32			m_nSize;
+			ReadArrayFun	m_funRead;
+			WriteArrayFun	m_funWrite;
+		};
+
+		template<class Type>
+		static void			SwapBytes( Type& v );
+		template<class Type>
+		static void			ReadArrayData( lua_State* pL, 
+								const tbyte* pData, uint32 nCount, int32 nTable, bool bSwap );
+		template<class Type>
+		static void			WriteArrayData( lua_State* pL, 
+								tbyte* pData, uint32 nCount, int32 nTable, bool bSwap );
+		static const SArrayType* GetArrayType( lua_State* pL, int32 nStkID );
+		static bool			NeedSwap( lua_State* pL, int32 nStkID );
+
 		static int32		GetBit( lua_State* pL );
 		static int32		ReadBoolean( lua_State* pL );
 		static int32		ReadInt8( lua_State* pL );
@@ -242,6 +324,7 @@ namespace XS
 		static int32		ReadUCS( lua_State* pL );
 		static int32		ReadUCSCounts( lua_State* pL );
 		static int32		ReadBytes( lua_State* pL );
+		static int32		ReadArray( lua_State* pL );
 
 		static int32		SetBit( lua_State* pL );
 		static int32		WriteBoolean( lua_State* pL );
@@ -255,6 +338,7 @@ namespace XS
 		static int32		WriteUTF( lua_State* pL );
 		static int32		WriteUTFBytes( lua_State* pL );
 		static int32		WriteBytes( lua_State* pL );
+		static int32		WriteArray( lua_State* pL );
 
 		static int32		SetPosition( lua_State* pL );
 		static int32		GetPosition( lua_State* pL );
@@ -264,9 +348,14 @@ namespace XS
 
 		static int32		Reset( lua_State* pL );
 		static int32		Clear( lua_State* pL );
+		static int32		Slice( lua_State* pL );
 
 		friend void*		GetPointerFromLua( lua_State* pL, int32 nStkId );
 		friend void			PushPointerToLua( lua_State* pL, void* pBuffer );
+		friend void			PushBufferToLua( lua_State* pL, void* pBuffer, uint32 nSize );
+		friend void			WriteBufferStream( lua_State* pL, int32 nStkId, const void* pData, uint32 nSize );
+		friend const void*	ReadBufferStream( lua_State* pL, int32 nStkId, uint32& nSize );
+		friend void			SkipBufferStream( lua_State* pL, int32 nStkId, uint32 nSize );
 	};
 
 	inline bool CLuaBuffer::IsLightData( SBufferInfo* pInfo )
@@ -387,7 +476,7 @@ namespace XS
 
 	int32 CLuaBuffer::ReadInt64( lua_State* pL )
 	{
-		lua_pushnumber( pL, (double)ReadData<int64>( pL ) );
+		PushInt64ToLua( pL, ReadData<int64>( pL ), false );
 		return 1;
 	}
 
@@ -411,7 +500,7 @@ namespace XS
 
 	int32 CLuaBuffer::ReadUint64( lua_State* pL )
 	{
-		lua_pushnumber( pL, (double)ReadData<uint64>( pL ) );
+		PushInt64ToLua( pL, (int64)ReadData<uint64>( pL ), true );
 		return 1;
 	}
 
@@ -486,17 +575,9 @@ namespace XS
 		}
 		pInfo->nPosition += sizeof(uint16) + nLen*sizeof(uint16);
 		CScriptLua* pScript = CScriptLua::GetScript( pL );
-		pScript->m_szTempUcs2.resize( nLen );
-		for( uint32 i = 0; i < nLen; i++ )
-			pScript->m_szTempUcs2[i] = szUtf16[i];
-		pScript->m_szTempUtf8.resize( nLen*6 );
-		static std::codecvt_utf8<wchar_t> UtfCvt;
-		std::codecvt_utf8<wchar_t>::state_type State{};
-		const wchar_t* szUcs = pScript->m_szTempUcs2.c_str();
-		char* szUtf = &pScript->m_szTempUtf8[0];
-		UtfCvt.out( State, szUcs, szUcs + nLen, szUcs, szUtf, szUtf + nLen*6, szUtf );
-		nLen = (uint16)( szUtf - &pScript->m_szTempUtf8[0] );
-		lua_pushlstring( pL, pScript->m_szTempUtf8.c_str(), nLen );
+		pScript->m_szTempUtf8.resize( nLen*3 + 1 );
+		size_t nUtf8Len = Utf16ToUtf8( &pScript->m_szTempUtf8[0], szUtf16, nLen );
+		lua_pushlstring( pL, pScript->m_szTempUtf8.c_str(), nUtf8Len );
 		return 1;
 	}
 
@@ -516,17 +597,9 @@ namespace XS
 		pInfo->nPosition += nLen*sizeof(uint16);
 
 		CScriptLua* pScript = CScriptLua::GetScript( pL );
-		pScript->m_szTempUcs2.resize( nLen );
-		for( uint32 i = 0; i < nLen; i++ )
-			pScript->m_szTempUcs2[i] = szUtf16[i];
-		pScript->m_szTempUtf8.resize( nLen*6 );
-		static std::codecvt_utf8<wchar_t> UtfCvt;
-		std::codecvt_utf8<wchar_t>::state_type State{};
-		const wchar_t* szUcs = pScript->m_szTempUcs2.c_str();
-		char* szUtf = &pScript->m_szTempUtf8[0];
-		UtfCvt.out( State, szUcs, szUcs + nLen, szUcs, szUtf, szUtf + nLen*6, szUtf );
-		nLen = (uint16)( szUtf - &pScript->m_szTempUtf8[0] );
-		lua_pushlstring( pL, pScript->m_szTempUtf8.c_str(), nLen );
+		pScript->m_szTempUtf8.resize( nLen*3 + 1 );
+		size_t nUtf8Len = Utf16ToUtf8( &pScript->m_szTempUtf8[0], szUtf16, nLen );
+		lua_pushlstring( pL, pScript->m_szTempUtf8.c_str(), nUtf8Len );
 		return 1;
 	}
 
@@ -663,7 +736,7 @@ namespace XS
 
 	int32 CLuaBuffer::WriteInt64( lua_State* pL )
 	{
-		WriteData( pL, (int64)GetNumFromLua( pL, 2 ) );
+		WriteData( pL, GetInt64FromLua( pL, 2, false ) );
 		return 0;
 	}
 
@@ -675,7 +748,7 @@ namespace XS
 
 	int32 CLuaBuffer::WriteUint64( lua_State* pL )
 	{
-		WriteData( pL, (uint64)GetNumFromLua( pL, 2 ) );
+		WriteData( pL, (uint64)GetInt64FromLua( pL, 2, true ) );
 		return 0;
 	}
 	
@@ -874,6 +947,181 @@ namespace XS
 		return 0;
 	}
 
+	// buffer:Slice( nOffset [, nSize] ) 返回共享同一块内存的视图，不复制数据
+	int32 CLuaBuffer::Slice( lua_State* pL )
+	{
+		uint32 nArg = lua_gettop( pL );
+		uint32 nOffset = nArg >= 2 ? (uint32)(int64)GetNumFromLua( pL, 2 ) : 0;
+		SBufferInfo* pInfo = GetBufferInfo( pL, 1 );
+		if( !pInfo || !pInfo->pBuffer || nOffset > pInfo->nDataSize )
+		{
+			luaL_error( pL, "invalid buffer" );
+			return 0;
+		}
+
+		// C++指针没有边界，必须指定视图大小
+		if( nArg < 3 && pInfo->nDataSize == INVALID_32BITID )
+		{
+			luaL_error( pL, "Slice of native pointer need size" );
+			return 0;
+		}
+
+		uint32 nSize = nArg >= 3 ? 
+			(uint32)(int64)GetNumFromLua( pL, 3 ) : pInfo->nDataSize - nOffset;
+		if( nSize > pInfo->nDataSize - nOffset )
+		{
+			luaL_error( pL, "invalid size" );
+			return 0;
+		}
+		lua_settop( pL, 1 );
+		PushBufferToLua( pL, pInfo->pBuffer + nOffset, nSize );
+
+		// 视图持有底层内存所在的userdata，原缓冲区扩容后视图仍指向旧的内存
+		lua_pushstring( pL, s_szLuaBufferOwner );
+		lua_pushstring( pL, IsLightData( pInfo ) ? s_szLuaBufferOwner : s_szLuaBufferInfo );
+		lua_rawget( pL, 1 );
+		lua_rawset( pL, 2 );
+		return 1;
+	}
+
+	//=====================================================================
+	// 批量读写，一次调用读写N个同类型的数值
+	//=====================================================================
+	template<class Type>
+	inline void CLuaBuffer::SwapBytes( Type& v )
+	{
+		tbyte* pByte = (tbyte*)&v;
+		for( uint32 i = 0; i < sizeof(Type)/2; i++ )
+			std::swap( pByte[i], pByte[sizeof(Type) - 1 - i] );
+	}
+
+	template<class Type>
+	void CLuaBuffer::ReadArrayData( lua_State* pL, 
+		const tbyte* pData, uint32 nCount, int32 nTable, bool bSwap )
+	{
+		for( uint32 i = 0; i < nCount; i++, pData += sizeof(Type) )
+		{
+			Type data;
+			memcpy( &data, pData, sizeof(Type) );
+			if( bSwap )
+				SwapBytes( data );
+			TLuaValue<Type>::GetInst().PushToVM( 0, pL, (char*)&data );
+			lua_rawseti( pL, nTable, i + 1 );
+		}
+	}
+
+	template<class Type>
+	void CLuaBuffer::WriteArrayData( lua_State* pL, 
+		tbyte* pData, uint32 nCount, int32 nTable, bool bSwap )
+	{
+		for( uint32 i = 0; i < nCount; i++, pData += sizeof(Type) )
+		{
+			lua_rawgeti( pL, nTable, i + 1 );
+			Type data;
+			TLuaValue<Type>::GetInst().GetFromVM( 0, pL, (char*)&data, -1 );
+			lua_pop( pL, 1 );
+			if( bSwap )
+				SwapBytes( data );
+			memcpy( pData, &data, sizeof(Type) );
+		}
+	}
+
+	const CLuaBuffer::SArrayType* CLuaBuffer::GetArrayType( lua_State* pL, int32 nStkID )
+	{
+		#define ARRAY_TYPE( name, type ) \
+		{ name, sizeof(type), &CLuaBuffer::ReadArrayData<type>, &CLuaBuffer::WriteArrayData<type> }
+
+		static SArrayType s_aryType[] = 
+		{
+			ARRAY_TYPE( "int8",		int8 ),
+			ARRAY_TYPE( "uint8",	uint8 ),
+			ARRAY_TYPE( "int16",	int16 ),
+			ARRAY_TYPE( "uint16",	uint16 ),
+			ARRAY_TYPE( "int32",	int32 ),
+			ARRAY_TYPE( "uint32",	uint32 ),
+			ARRAY_TYPE( "int64",	int64 ),
+			ARRAY_TYPE( "uint64",	uint64 ),
+			ARRAY_TYPE( "float",	float ),
+			ARRAY_TYPE( "double",	double ),
+		};
+		#undef ARRAY_TYPE
+
+		const char* szType = lua_tostring( pL, nStkID );
+		for( uint32 i = 0; szType && i < ELEM_COUNT( s_aryType ); i++ )
+			if( !strcmp( s_aryType[i].m_szName, szType ) )
+				return &s_aryType[i];
+		luaL_error( pL, "invalid array type:%s", szType ? szType : "nil" );
+		return NULL;
+	}
+
+	bool CLuaBuffer::NeedSwap( lua_State* pL, int32 nStkID )
+	{
+		// 参数为true表示缓冲区内的数据是大端序
+		static const uint16 s_nEndianTest = 1;
+		bool bBigEndian = lua_toboolean( pL, nStkID ) != 0;
+		bool bLocalBigEndian = *(const uint8*)&s_nEndianTest == 0;
+		return bBigEndian != bLocalBigEndian;
+	}
+
+	// buffer:ReadArray( "float", nCount [, tbl [, bBigEndian]] ) 返回table
+	int32 CLuaBuffer::ReadArray( lua_State* pL )
+	{
+		const SArrayType* pType = GetArrayType( pL, 2 );
+		uint32 nCount = (uint32)GetNumFromLua( pL, 3 );
+		bool bSwap = NeedSwap( pL, 5 );
+		SBufferInfo* pInfo = GetBufferInfo( pL, 1 );
+		if( !pInfo || !pInfo->pBuffer || pInfo->nPosition > pInfo->nDataSize ||
+			nCount > ( pInfo->nDataSize - pInfo->nPosition )/pType->m_nSize )
+		{
+			luaL_error( pL, "invalid buffer" );
+			return 0;
+		}
+
+		if( lua_type( pL, 4 ) != LUA_TTABLE )
+		{
+			lua_settop( pL, 3 );
+			lua_createtable( pL, nCount, 0 );
+		}
+		else
+		{
+			lua_settop( pL, 4 );
+		}
+
+		pType->m_funRead( pL, pInfo->pBuffer + pInfo->nPosition, nCount, 4, bSwap );
+		pInfo->nPosition += nCount*pType->m_nSize;
+		return 1;
+	}
+
+	// buffer:WriteArray( "float", tbl [, nCount [, bBigEndian]] )
+	int32 CLuaBuffer::WriteArray( lua_State* pL )
+	{
+		const SArrayType* pType = GetArrayType( pL, 2 );
+		if( lua_type( pL, 3 ) != LUA_TTABLE )
+		{
+			luaL_error( pL, "WriteArray Invalid Param" );
+			return 0;
+		}
+
+		uint32 nCount = lua_isnoneornil( pL, 4 ) ? 
+			(uint32)lua_objlen( pL, 3 ) : (uint32)GetNumFromLua( pL, 4 );
+		bool bSwap = NeedSwap( pL, 5 );
+		if( nCount > 200*1024*1024/pType->m_nSize )
+		{
+			luaL_error( pL, "invalid size" );
+			return 0;
+		}
+
+		SBufferInfo* pInfo = GetBufferInfo( pL, 1 );
+		uint32 nNewSize = ( pInfo ? pInfo->nPosition : 0 ) + nCount*pType->m_nSize;
+		pInfo = CheckBufferSpace( pInfo, nNewSize, pL, 1 );
+		pType->m_funWrite( pL, pInfo->pBuffer + pInfo->nPosition, nCount, 3, bSwap );
+		lua_settop( pL, 0 );
+
+		pInfo->nPosition += nCount*pType->m_nSize;
+		pInfo->nDataSize = std::max<uint32>( pInfo->nPosition, pInfo->nDataSize );
+		return 0;
+	}
+
 	void RegisterPointerClass( CScriptLua* pScript )
 	{
 		char szSrc[256];
@@ -904,6 +1152,7 @@ namespace XS
 		REGISTER( ReadUCS );
 		REGISTER( ReadUCSCounts );
 		REGISTER( ReadBytes );
+		REGISTER( ReadArray );
 
 		REGISTER( SetBit );
 		REGISTER( WriteBoolean );
@@ -917,6 +1166,7 @@ namespace XS
 		REGISTER( WriteUTF );
 		REGISTER( WriteUTFBytes );
 		REGISTER( WriteBytes );
+		REGISTER( WriteArray );
 
 		REGISTER( SetPosition );
 		REGISTER( GetPosition );
@@ -924,10 +1174,260 @@ namespace XS
 		REGISTER( SetDataSize );
 		REGISTER( Reset );
 		REGISTER( Clear );
+		REGISTER( Slice );
 
         lua_pop( pL, 1 );
 	}
 
+	//=====================================================================
+	/// 64位整数
+	/// 2^53以内的值仍然是number，超出的装箱为userdata，支持算术、比较和tostring
+	/// 同值的装箱整数是同一个userdata，可以作为table的键
+	/// Lua 5.1只在两边同为userdata时调用__eq/__lt/__le，装箱整数不能直接和number比较，
+	/// box == 1 恒为false，box < 1 报错，需要先Int64( 1 )或者box:ToNumber()
+	//=====================================================================
+	static const char* s_szLuaInt64Class = "__int64_metatable";
+	static const char* s_szLuaInt64Cache = "__int64_cache";
+	#define MAX_SAFE_INTEGER	9007199254740992LL
+
+	struct SLuaInt64
+	{
+		int64			nValue;
+		bool			bUnsigned;
+	};
+
+	static SLuaInt64* ToInt64Box( lua_State* pL, int32 nStkId )
+	{
+		if( lua_type( pL, nStkId ) != LUA_TUSERDATA || !lua_getmetatable( pL, nStkId ) )
+			return NULL;
+		luaL_getmetatable( pL, s_szLuaInt64Class );
+		bool bBox = lua_rawequal( pL, -1, -2 ) != 0;
+		lua_pop( pL, 2 );
+		return bBox ? (SLuaInt64*)lua_touserdata( pL, nStkId ) : NULL;
+	}
+
+	static void NewInt64Box( lua_State* pL, int64 nValue, bool bUnsigned )
+	{
+		// 以值和符号为键在弱值表里查找已有的装箱整数
+		char szKey[sizeof( int64 ) + 1];
+		memcpy( szKey, &nValue, sizeof( int64 ) );
+		szKey[sizeof( int64 )] = bUnsigned ? 1 : 0;
+		lua_pushlightuserdata( pL, (void*)s_szLuaInt64Cache );
+		lua_rawget( pL, LUA_REGISTRYINDEX );
+		lua_pushlstring( pL, szKey, sizeof( szKey ) );
+		lua_rawget( pL, -2 );
+		if( !lua_isnil( pL, -1 ) )
+		{
+			lua_remove( pL, -2 );
+			return;
+		}
+		lua_pop( pL, 1 );
+
+		SLuaInt64* pBox = (SLuaInt64*)lua_newuserdata( pL, sizeof( SLuaInt64 ) );
+		pBox->nValue = nValue;
+		pBox->bUnsigned = bUnsigned;
+		luaL_getmetatable( pL, s_szLuaInt64Class );
+		lua_setmetatable( pL, -2 );
+		lua_pushlstring( pL, szKey, sizeof( szKey ) );
+		lua_pushvalue( pL, -2 );
+		lua_rawset( pL, -4 );
+		lua_remove( pL, -2 );
+	}
+
+	bool GetBoxedInt64( lua_State* pL, int32 nStkId, int64& nValue, bool& bUnsigned )
+	{
+		SLuaInt64* pBox = ToInt64Box( pL, nStkId );
+		if( !pBox )
+			return false;
+		nValue = pBox->nValue;
+		bUnsigned = pBox->bUnsigned;
+		return true;
+	}
+
+	int64 GetInt64FromLua( lua_State* pL, int32 nStkId, bool bUnsigned )
+	{
+		nStkId = ToAbsStackIndex( pL, nStkId );
+		int32 nType = lua_type( pL, nStkId );
+		if( nType == LUA_TNUMBER )
+		{
+			double fValue = lua_tonumber( pL, nStkId );
+			return fValue < 0 ? (int64)fValue : (int64)(uint64)fValue;
+		}
+		if( nType == LUA_TUSERDATA )
+		{
+			SLuaInt64* pBox = ToInt64Box( pL, nStkId );
+			return pBox ? pBox->nValue : 0;
+		}
+		if( nType == LUA_TSTRING )
+		{
+			const char* szValue = lua_tostring( pL, nStkId );
+			if( bUnsigned )
+				return (int64)strtoull( szValue, NULL, 0 );
+			return (int64)strtoll( szValue, NULL, 0 );
+		}
+		double fValue = GetNumFromLua( pL, nStkId );
+		return fValue < 0 ? (int64)fValue : (int64)(uint64)fValue;
+	}
+
+	void PushInt64ToLua( lua_State* pL, int64 nValue, bool bUnsigned )
+	{
+		if( bUnsigned ? (uint64)nValue <= (uint64)MAX_SAFE_INTEGER
+			: ( nValue >= -MAX_SAFE_INTEGER && nValue <= MAX_SAFE_INTEGER ) )
+			return lua_pushnumber( pL, bUnsigned ? (double)(uint64)nValue : (double)nValue );
+		NewInt64Box( pL, nValue, bUnsigned );
+	}
+
+	// 操作数可以是装箱整数或者number，有一个是无符号的结果就是无符号的
+	static int64 GetInt64Operand( lua_State* pL, int32 nStkId, bool& bUnsigned )
+	{
+		SLuaInt64* pBox = ToInt64Box( pL, nStkId );
+		if( pBox )
+		{
+			bUnsigned = bUnsigned || pBox->bUnsigned;
+			return pBox->nValue;
+		}
+		if( lua_type( pL, nStkId ) != LUA_TNUMBER && lua_type( pL, nStkId ) != LUA_TSTRING )
+			luaL_typerror( pL, nStkId, "int64" );
+		return GetInt64FromLua( pL, nStkId, false );
+	}
+
+	struct SInt64Operator
+	{
+		static int32 Arith( lua_State* pL, char cOperator )
+		{
+			bool bUnsigned = false;
+			int64 a = GetInt64Operand( pL, 1, bUnsigned );
+			int64 b = cOperator == '-' && lua_isnone( pL, 2 ) ? 0 : GetInt64Operand( pL, 2, bUnsigned );
+			int64 r = 0;
+			switch( cOperator )
+			{
+			case '+': r = (int64)( (uint64)a + (uint64)b ); break;
+			case '-': r = (int64)( (uint64)a - (uint64)b ); break;
+			case '*': r = (int64)( (uint64)a * (uint64)b ); break;
+			case 'n': r = (int64)( 0 - (uint64)a ); break;
+			case '/':
+			case '%':
+				if( b == 0 )
+					return luaL_error( pL, "int64 divided by zero" );
+				if( bUnsigned )
+					r = (int64)( cOperator == '/' ? (uint64)a / (uint64)b : (uint64)a % (uint64)b );
+				else if( b == -1 )
+					r = cOperator == '/' ? (int64)( 0 - (uint64)a ) : 0;
+				else
+					r = cOperator == '/' ? a / b : a % b;
+				break;
+			}
+			PushInt64ToLua( pL, r, bUnsigned );
+			return 1;
+		}
+
+		static int32 Compare( lua_State* pL, char cOperator )
+		{
+			bool bUnsigned = false;
+			int64 a = GetInt64Operand( pL, 1, bUnsigned );
+			int64 b = GetInt64Operand( pL, 2, bUnsigned );
+			bool bLess = bUnsigned ? (uint64)a < (uint64)b : a < b;
+			bool bResult = cOperator == '=' ? a == b : 
+				( cOperator == '<' ? bLess : ( bLess || a == b ) );
+			lua_pushboolean( pL, bResult );
+			return 1;
+		}
+
+		static int32 Add( lua_State* pL ) { return Arith( pL, '+' ); }
+		static int32 Sub( lua_State* pL ) { return Arith( pL, '-' ); }
+		static int32 Mul( lua_State* pL ) { return Arith( pL, '*' ); }
+		static int32 Div( lua_State* pL ) { return Arith( pL, '/' ); }
+		static int32 Mod( lua_State* pL ) { return Arith( pL, '%' ); }
+		static int32 Unm( lua_State* pL ) { return Arith( pL, 'n' ); }
+		static int32 Eq( lua_State* pL ) { return Compare( pL, '=' ); }
+		static int32 Lt( lua_State* pL ) { return Compare( pL, '<' ); }
+		static int32 Le( lua_State* pL ) { return Compare( pL, 'l' ); }
+
+		static int32 ToString( lua_State* pL )
+		{
+			bool bUnsigned = false;
+			int64 nValue = GetInt64Operand( pL, 1, bUnsigned );
+			char szBuf[32];
+			if( bUnsigned )
+				sprintf( szBuf, "%llu", (unsigned long long)nValue );
+			else
+				sprintf( szBuf, "%lld", (long long)nValue );
+			lua_pushstring( pL, szBuf );
+			return 1;
+		}
+
+		static int32 Concat( lua_State* pL )
+		{
+			for( int32 i = 1; i <= 2; i++ )
+			{
+				if( !ToInt64Box( pL, i ) )
+					continue;
+				ToString( pL );
+				lua_replace( pL, i );
+				lua_settop( pL, 2 );
+			}
+			lua_concat( pL, 2 );
+			return 1;
+		}
+
+		static int32 ToNumber( lua_State* pL )
+		{
+			bool bUnsigned = false;
+			int64 nValue = GetInt64Operand( pL, 1, bUnsigned );
+			lua_pushnumber( pL, bUnsigned ? (double)(uint64)nValue : (double)nValue );
+			return 1;
+		}
+
+		// Int64( v ) / UInt64( v )，v可以是number、字符串或者装箱整数
+		static int32 New( lua_State* pL, bool bUnsigned )
+		{
+			NewInt64Box( pL, GetInt64FromLua( pL, 1, bUnsigned ), bUnsigned );
+			return 1;
+		}
+		static int32 NewInt64( lua_State* pL ) { return New( pL, false ); }
+		static int32 NewUInt64( lua_State* pL ) { return New( pL, true ); }
+	};
+
+	void RegisterInt64Class( CScriptLua* pScript )
+	{
+		lua_State* pL = pScript->GetLuaState();
+		lua_pushlightuserdata( pL, (void*)s_szLuaInt64Cache );
+		lua_newtable( pL );
+		lua_newtable( pL );
+		lua_pushstring( pL, "v" );
+		lua_setfield( pL, -2, "__mode" );
+		lua_setmetatable( pL, -2 );
+		lua_rawset( pL, LUA_REGISTRYINDEX );
+
+		luaL_newmetatable( pL, s_szLuaInt64Class );
+
+		#define REGISTER_INT64( name, f ) \
+		lua_pushcfunction( pL, SInt64Operator::f ); \
+		lua_setfield( pL, -2, name )
+
+		REGISTER_INT64( "__add", Add );
+		REGISTER_INT64( "__sub", Sub );
+		REGISTER_INT64( "__mul", Mul );
+		REGISTER_INT64( "__div", Div );
+		REGISTER_INT64( "__mod", Mod );
+		REGISTER_INT64( "__unm", Unm );
+		REGISTER_INT64( "__eq", Eq );
+		REGISTER_INT64( "__lt", Lt );
+		REGISTER_INT64( "__le", Le );
+		REGISTER_INT64( "__tostring", ToString );
+		REGISTER_INT64( "__concat", Concat );
+
+		lua_newtable( pL );
+		REGISTER_INT64( "ToNumber", ToNumber );
+		REGISTER_INT64( "ToString", ToString );
+		lua_setfield( pL, -2, "__index" );
+		lua_pop( pL, 1 );
+
+		lua_register( pL, "Int64", &SInt64Operator::NewInt64 );
+		lua_register( pL, "UInt64", &SInt64Operator::NewUInt64 );
+		#undef REGISTER_INT64
+	}
+
 	//=====================================================================
 	/// lua对C++数据的操作方法封装
 	//=====================================================================
@@ -1057,6 +1557,68 @@ namespace XS
 		lua_pop( pL, 1 );
 	}
 
+	void PushBufferToLua( lua_State* pL, void* pBuffer, uint32 nSize )
+	{
+		// 有边界的视图，不挂到全局表上，每次都是新的对象
+		lua_newtable( pL );
+		int32 nStkId = ToAbsStackIndex( pL, -1 );
+		lua_getglobal( pL, s_szLuaBufferClass );
+		if( lua_isnil( pL, -1 ) )//szClass必须被注册
+		{
+			luaL_error( pL, "PushToVM Class:%s", s_szLuaBufferClass );
+			return;
+		}
+		lua_setmetatable( pL, nStkId );
+
+		lua_pushstring( pL, s_szLuaBufferInfo );
+		SBufferInfo* pInfo = (SBufferInfo*)lua_newuserdata( pL, sizeof( SBufferInfo ) );
+		pInfo->pBuffer = (tbyte*)pBuffer;
+		pInfo->nPosition = 0;
+		pInfo->nDataSize = nSize;
+		pInfo->nCapacity = nSize;
+		lua_rawset( pL, nStkId );
+	}
+
+	void NewBufferStreamInLua( lua_State* pL )
+	{
+		// 空的缓冲区，第一次写入时才分配内存
+		lua_newtable( pL );
+		lua_getglobal( pL, s_szLuaBufferClass );
+		if( lua_isnil( pL, -1 ) )//szClass必须被注册
+		{
+			luaL_error( pL, "PushToVM Class:%s", s_szLuaBufferClass );
+			return;
+		}
+		lua_setmetatable( pL, -2 );
+	}
+
+	void WriteBufferStream( lua_State* pL, int32 nStkId, const void* pData, uint32 nSize )
+	{
+		nStkId = ToAbsStackIndex( pL, nStkId );
+		SBufferInfo* pInfo = CLuaBuffer::GetBufferInfo( pL, nStkId );
+		pInfo = CLuaBuffer::CheckBufferSpace( pInfo, ( pInfo ? pInfo->nPosition : 0 ) + nSize, pL, nStkId );
+		memcpy( pInfo->pBuffer + pInfo->nPosition, pData, nSize );
+		pInfo->nPosition += nSize;
+		pInfo->nDataSize = std::max<uint32>( pInfo->nPosition, pInfo->nDataSize );
+	}
+
+	const void* ReadBufferStream( lua_State* pL, int32 nStkId, uint32& nSize )
+	{
+		SBufferInfo* pInfo = CLuaBuffer::GetBufferInfo( pL, nStkId );
+		nSize = 0;
+		if( !pInfo || !pInfo->pBuffer || pInfo->nPosition > pInfo->nDataSize )
+			return NULL;
+		nSize = pInfo->nDataSize - pInfo->nPosition;
+		return pInfo->pBuffer + pInfo->nPosition;
+	}
+
+	void SkipBufferStream( lua_State* pL, int32 nStkId, uint32 nSize )
+	{
+		SBufferInfo* pInfo = CLuaBuffer::GetBufferInfo( pL, nStkId );
+		if( pInfo )
+			pInfo->nPosition += nSize;
+	}
+
 	//=====================================================================
 	/// 所有Lua数据类型
 	//=====================================================================
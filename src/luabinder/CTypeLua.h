@@ -22,7 +22,18 @@ namespace XS
 	double			GetNumFromLua( lua_State* pL, int32 nStkId );
 	void*			GetPointerFromLua( lua_State* pL, int32 nStkId );
 	void			PushPointerToLua( lua_State* pL, void* pBuffer );
+	void			PushBufferToLua( lua_State* pL, void* pBuffer, uint32 nSize );
 	void			RegisterPointerClass( CScriptLua* pScript );
+	/// CBufferStream当前位置的读写，Serialize/Deserialize直接使用脚本的缓冲区
+	void			NewBufferStreamInLua( lua_State* pL );
+	void			WriteBufferStream( lua_State* pL, int32 nStkId, const void* pData, uint32 nSize );
+	const void*		ReadBufferStream( lua_State* pL, int32 nStkId, uint32& nSize );
+	void			SkipBufferStream( lua_State* pL, int32 nStkId, uint32 nSize );
+	/// 64位整数超过2^53时装箱为userdata，不丢精度
+	int64			GetInt64FromLua( lua_State* pL, int32 nStkId, bool bUnsigned );
+	void			PushInt64ToLua( lua_State* pL, int64 nValue, bool bUnsigned );
+	bool			GetBoxedInt64( lua_State* pL, int32 nStkId, int64& nValue, bool& bUnsigned );
+	void			RegisterInt64Class( CScriptLua* pScript );
 	CLuaTypeBase*	GetLuaTypeBase( DataType eType );
 
     //=====================================================================
@@ -90,6 +101,38 @@ namespace XS
 	( DataType eType, lua_State* pL, char* pDataBuf )
 	{ lua_pushboolean( pL, *(bool*)( pDataBuf ) ); }
 
+	template<> inline void TLuaValue<int64>::GetFromVM
+	( DataType eType, lua_State* pL, char* pDataBuf, int32 nStkId )
+	{ *(int64*)( pDataBuf ) = GetInt64FromLua( pL, nStkId, false ); }
+
+	template<> inline void TLuaValue<int64>::PushToVM
+	( DataType eType, lua_State* pL, char* pDataBuf )
+	{ PushInt64ToLua( pL, *(int64*)( pDataBuf ), false ); }
+
+	template<> inline void TLuaValue<uint64>::GetFromVM
+	( DataType eType, lua_State* pL, char* pDataBuf, int32 nStkId )
+	{ *(uint64*)( pDataBuf ) = (uint64)GetInt64FromLua( pL, nStkId, true ); }
+
+	template<> inline void TLuaValue<uint64>::PushToVM
+	( DataType eType, lua_State* pL, char* pDataBuf )
+	{ PushInt64ToLua( pL, (int64)*(uint64*)( pDataBuf ), true ); }
+
+	template<> inline void TLuaValue<long>::GetFromVM
+	( DataType eType, lua_State* pL, char* pDataBuf, int32 nStkId )
+	{ *(long*)( pDataBuf ) = (long)GetInt64FromLua( pL, nStkId, false ); }
+
+	template<> inline void TLuaValue<long>::PushToVM
+	( DataType eType, lua_State* pL, char* pDataBuf )
+	{ PushInt64ToLua( pL, (int64)*(long*)( pDataBuf ), false ); }
+
+	template<> inline void TLuaValue<ulong>::GetFromVM
+	( DataType eType, lua_State* pL, char* pDataBuf, int32 nStkId )
+	{ *(ulong*)( pDataBuf ) = (ulong)GetInt64FromLua( pL, nStkId, true ); }
+
+	template<> inline void TLuaValue<ulong>::PushToVM
+	( DataType eType, lua_State* pL, char* pDataBuf )
+	{ PushInt64ToLua( pL, (int64)(uint64)*(ulong*)( pDataBuf ), true ); }
+
 	template<> inline void TLuaValue<void*>::GetFromVM
 	( DataType eType, lua_State* pL, char* pDataBuf, int32 nStkId )
 	{ *(void**)( pDataBuf ) = GetPointerFromLua( pL, nStkId ); }
@@ -1,11 +1,10 @@
 ﻿#include "common/Http.h"
 #include "common/TStrStream.h"
+#include "common/UtfConvert.h"
 #include "CDebugJS.h"
 #include "CScriptJS.h"
 #include "V8Context.h"
 #include <memory>
-#include <locale>
-#include <codecvt>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -388,13 +387,9 @@ namespace XS
 		m_strUtf8Buffer.assign( szBuffer, nSize );
 		if( !buffer.is8Bit() )
 		{
-			m_strUtf8Buffer.resize( nSize * 3 );
-			static std::codecvt_utf8<uint16_t> UtfCvt;
-			std::codecvt_utf8<uint16_t>::state_type State{};
-			const uint16_t* szUcs = buffer.characters16();
-			char* szUtf = &m_strUtf8Buffer[0];
-			UtfCvt.out( State, szUcs, szUcs + nSize, szUcs, szUtf, szUtf + nSize*3, szUtf );
-			nSize = (uint32)( szUtf - &m_strUtf8Buffer[0] );
+			m_strUtf8Buffer.resize( nSize * 3 + 1 );
+			const uint16* szUtf16 = (const uint16*)buffer.characters16();
+			nSize = (uint32)Utf16ToUtf8( &m_strUtf8Buffer[0], szUtf16, nSize );
 			szBuffer = m_strUtf8Buffer.c_str();
 		}
 
@@ -413,13 +408,9 @@ namespace XS
 		uint32 nSize = (uint32)buffer.length();
 		if (!buffer.is8Bit())
 		{
-			m_strUtf8Buffer.resize( nSize * 3 );
-			static std::codecvt_utf8<uint16_t> UtfCvt;
-			std::codecvt_utf8<uint16_t>::state_type State{};
-			const uint16_t* szUcs = buffer.characters16();
-			char* szUtf = &m_strUtf8Buffer[0];
-			UtfCvt.out( State, szUcs, szUcs + nSize, szUcs, szUtf, szUtf + nSize * 3, szUtf );
-			nSize = (uint32)( szUtf - &m_strUtf8Buffer[0] );
+			m_strUtf8Buffer.resize( nSize * 3 + 1 );
+			const uint16* szUtf16 = (const uint16*)buffer.characters16();
+			nSize = (uint32)Utf16ToUtf8( &m_strUtf8Buffer[0], szUtf16, nSize );
 			szBuffer = m_strUtf8Buffer.c_str();
 		}
 
@@ -1,5 +1,7 @@
 ﻿#include "common/TStrStream.h"
 #include "core/CCallInfo.h"
+#include "core/CSharedData.h"
+#include "core/CScriptSerial.h"
 #include "core/CClassInfo.h"
 #include "CScriptJS.h"
 #include "CTypeJS.h"
@@ -44,6 +46,17 @@ namespace XS
 	//====================================================================================
     // CScriptJS
 	//====================================================================================
+	static bool s_bV8Initialized = false;
+	static bool s_bForkMode = false;
+
+	bool CScriptJS::EnableForkMode()
+	{
+		if( s_bV8Initialized )
+			return s_bForkMode;
+		s_bForkMode = true;
+		return true;
+	}
+
     CScriptJS::CScriptJS( uint16 nDebugPort )
 		: m_pFreeObjectInfo( NULL )
 		, m_pV8Context( new SV8Context( this ) )
@@ -62,7 +75,11 @@ namespace XS
 				m_snapshot.raw_size = sizeof(snapshot_blob);
 				v8::V8::SetNativesDataBlob(&m_natives);
 				v8::V8::SetSnapshotDataBlob(&m_snapshot);
-				m_platform = v8::platform::CreateDefaultPlatform();
+				static const char s_szSingleThread[] = "--single-threaded";
+				if( s_bForkMode )
+					v8::V8::SetFlagsFromString( s_szSingleThread, sizeof( s_szSingleThread ) - 1 );
+				m_platform = v8::platform::CreateDefaultPlatform( s_bForkMode ? 1 : 0 );
+				s_bV8Initialized = true;
 				v8::V8::InitializePlatform( m_platform );
 				v8::V8::Initialize();
 				m_create_params.array_buffer_allocator =
@@ -88,8 +105,16 @@ namespace XS
 		// Create a stack-allocated handle scope.
 		v8::HandleScope handle_scope(m_pV8Context->m_pIsolate);
 
-		// Create a new context.
-		v8::Local<v8::Context> context = v8::Context::New(m_pV8Context->m_pIsolate);
+		// Create a new context, registered classes are bound by the 
+		// global interceptor when they are first accessed
+		v8::Local<v8::ObjectTemplate> globalTemplate = v8::ObjectTemplate::New( pIsolate );
+		globalTemplate->SetHandler( v8::NamedPropertyHandlerConfiguration( 
+			&SV8Context::LazyBindClass, nullptr, nullptr, nullptr, nullptr, 
+			v8::External::New( pIsolate, this ), v8::PropertyHandlerFlags( 
+			(int32)v8::PropertyHandlerFlags::kNonMasking | 
+			(int32)v8::PropertyHandlerFlags::kOnlyInterceptStrings ) ) );
+		v8::Local<v8::Context> context = 
+			v8::Context::New( m_pV8Context->m_pIsolate, nullptr, globalTemplate );
 		m_pV8Context->m_Context.Reset(pIsolate, context);
 
 		v8::Context::Scope context_scope(context);
@@ -111,26 +136,24 @@ namespace XS
 
 		m_pDebugger = new CDebugJS( this, nDebugPort );
 
-		m_pV8Context->m_CppField.Reset(pIsolate, 
-			v8::String::NewFromUtf8(pIsolate, "__cpp_obj_info__" ) );
-		m_pV8Context->m_Prototype.Reset(pIsolate, 
-			v8::String::NewFromUtf8(pIsolate, "prototype" ) );
 		m_pV8Context->m_Deconstruction.Reset(pIsolate, 
 			v8::String::NewFromUtf8(pIsolate, "Deconstruction" ) );
-		m_pV8Context->m___proto__.Reset(pIsolate, 
-			v8::String::NewFromUtf8(pIsolate, "__proto__" ) );
 
 		RunString(	
 			"var XScript = {};\n"
 			"(function()\n"
 			"{\n"
+			"	var s_mapClass = {};\n"
+			"	var s_mapReload = null;\n"
 			"	XScript.class = function(Derive, szGlobalName, Base)\n"
 			"	{\n"
 			"		if (Base)\n"
 			"		{\n"
-			"			var Super = function() {};\n"
-			"			Super.prototype = Base.prototype;\n"
-			"			Derive.prototype = new Super();\n"
+			// C++类的模板已经继承了基类模板，脚本类必须用class ... extends派生并调用super()，
+			// 否则实例不是由C++类的模板构造的，调用C++方法时会因为接收者签名不符而失败
+			"			if (Object.getPrototypeOf(Derive.prototype) !== Base.prototype)\n"
+			"				throw new TypeError('XScript.class: ' + Derive.name + \n"
+			"					' must be declared as class ' + Derive.name + ' extends ' + Base.name);\n"
 
 			"			for (var Property in Base)\n"
 			"			{\n"
@@ -170,6 +193,7 @@ namespace XS
 			"			CurPackage = CurPackage[aryPath[i]];\n"
 			"		}\n"
 			"		CurPackage[aryPath[i]] = Derive;\n"
+			"		s_mapClass[szGlobalName] = Derive;\n"
 			"		Derive.prototype.__class__name__ = aryPath[i];\n"
 			"		Derive.prototype.__class__path__ = szGlobalName;\n"
 			"		return Derive;\n"
@@ -204,6 +228,58 @@ namespace XS
 			"		return obj;\n"
 			"	}\n"
 
+			// 热更新：新类的成员合并到旧类上，保留旧的构造函数和prototype，
+			// 已有的实例和子类直接使用新函数，ES6 class的prototype不可写所以不能反过来
+			"	XScript.__reloadBegin = function()\n"
+			"	{\n"
+			"		s_mapReload = {};\n"
+			"		for (var szName in s_mapClass)\n"
+			"			s_mapReload[szName] = s_mapClass[szName];\n"
+			"	}\n"
+
+			"	var s_setKeepMember = { 'constructor':1, '__class__':1, '__super':1, '__class__name__':1, '__class__path__':1 };\n"
+			"	var s_setKeepStatic = { 'prototype':1, 'length':1, 'name':1, 'caller':1, 'arguments':1, 'Alloc':1, 'Free':1 };\n"
+			"	function __mergeMembers(Target, Source, setKeep, szName, aryError)\n"
+			"	{\n"
+			"		var aryKeys = Object.getOwnPropertyNames(Source);\n"
+			"		for (var i = 0; i < aryKeys.length; i++)\n"
+			"		{\n"
+			"			if (setKeep[aryKeys[i]])\n"
+			"				continue;\n"
+			"			try\n"
+			"			{\n"
+			"				Object.defineProperty(Target, aryKeys[i], \n"
+			"					Object.getOwnPropertyDescriptor(Source, aryKeys[i]));\n"
+			"			}\n"
+			"			catch (e)\n"
+			"			{\n"
+			"				aryError.push(szName + '.' + aryKeys[i] + ': ' + e);\n"
+			"			}\n"
+			"		}\n"
+			"	}\n"
+
+			"	XScript.__reloadEnd = function()\n"
+			"	{\n"
+			"		var mapOld = s_mapReload || {};\n"
+			"		var aryError = [];\n"
+			"		s_mapReload = null;\n"
+			"		for (var szName in mapOld)\n"
+			"		{\n"
+			"			var Old = mapOld[szName], New = s_mapClass[szName];\n"
+			"			if (New === Old)\n"
+			"				continue;\n"
+			"			__mergeMembers(Old.prototype, New.prototype, s_setKeepMember, szName, aryError);\n"
+			"			__mergeMembers(Old, New, s_setKeepStatic, szName, aryError);\n"
+			"			var CurPackage = window, aryPath = szName.split('.');\n"
+			"			for (var i = 0; i < aryPath.length - 1; i++)\n"
+			"				CurPackage = CurPackage[aryPath[i]];\n"
+			"			CurPackage[aryPath[i]] = Old;\n"
+			"			s_mapClass[szName] = Old;\n"
+			"		}\n"
+			"		if (aryError.length)\n"
+			"			throw new Error('reload failed:\\n' + aryError.join('\\n'));\n"
+			"	}\n"
+
 			"	return this;\n"
 			"})()"
 		);
@@ -213,6 +289,10 @@ namespace XS
 		LocalValue XSClass = nsXSObject->Get(v8::String::NewFromUtf8(pIsolate, "class"));
 		m_pV8Context->m_XSClass.Reset(pIsolate, v8::Local<v8::Function>::Cast(XSClass));
 		m_pV8Context->m_XSNameSpace.Reset(pIsolate, nsXSObject);
+		nsXSObject->Set( context, v8::String::NewFromUtf8( pIsolate, "serialize" ),
+			v8::Function::New( pIsolate, &SV8Context::Serialize, ScriptContext ) );
+		nsXSObject->Set( context, v8::String::NewFromUtf8( pIsolate, "deserialize" ),
+			v8::Function::New( pIsolate, &SV8Context::Deserialize, ScriptContext ) );
 
 		BuildRegisterInfo();
     }
@@ -221,6 +301,13 @@ namespace XS
 	{
 		SAFE_DELETE( m_pDebugger );
 		m_pV8Context->ClearCppString((void*)(uintptr_t)(-1));
+		for( auto it = m_pV8Context->m_mapChunkCache.begin(); 
+			it != m_pV8Context->m_mapChunkCache.end(); ++it )
+			it->second.Reset();
+		m_pV8Context->m_mapChunkCache.clear();
+		m_pV8Context->ClearSharedData();
+		StopProfile( NULL );
+		m_pV8Context->ShutdownWatchdog();
 		m_pV8Context->m_Context.Reset();
 		m_pV8Context->m_pIsolate->Exit();
 		m_pV8Context->m_pIsolate->Dispose();
@@ -232,9 +319,59 @@ namespace XS
 			delete m_mapCallBase.GetFirst();
 		while( m_mapObjInfo.GetFirst() )
 			delete m_mapObjInfo.GetFirst();
+		m_hashObjInfo.clear();
 		delete m_pV8Context;
 	}
 
+	bool CScriptJS::PublishSharedData( const char* szName, const CSharedData* pData )
+	{
+		if( !szName || !pData || !pData->IsFrozen() )
+			return false;
+		v8::Isolate* isolate = m_pV8Context->m_pIsolate;
+		v8::HandleScope handle_scope( isolate );
+		v8::Local<v8::Context> context = m_pV8Context->m_Context.Get( isolate );
+		v8::Context::Scope context_scope( context );
+		LocalValue Value = m_pV8Context->NewSharedData( pData );
+		return context->Global()->Set( context, 
+			v8::String::NewFromUtf8( isolate, szName ), Value ).FromMaybe( false );
+	}
+
+	bool CScriptJS::PrepareFork()
+	{
+		if( !s_bForkMode || !CScriptBase::PrepareFork() )
+			return false;
+		// 确定要fork了才停线程，采样线程和看门狗线程不能带进子进程
+		StopProfile( NULL );
+		m_pV8Context->ShutdownWatchdog();
+		return true;
+	}
+
+	bool CScriptJS::SerializeGlobal( const char* szName, std::string& strBuffer )
+	{
+		v8::Isolate* isolate = m_pV8Context->m_pIsolate;
+		v8::HandleScope handle_scope( isolate );
+		v8::Local<v8::Context> context = m_pV8Context->m_Context.Get( isolate );
+		v8::Context::Scope context_scope( context );
+		LocalValue Value;
+		if( !context->Global()->Get( context, 
+			v8::String::NewFromUtf8( isolate, szName ) ).ToLocal( &Value ) )
+			return false;
+		return m_pV8Context->SerializeBuffer( Value, strBuffer );
+	}
+
+	bool CScriptJS::DeserializeGlobal( const char* szName, const void* pBuffer, size_t nSize )
+	{
+		v8::Isolate* isolate = m_pV8Context->m_pIsolate;
+		v8::HandleScope handle_scope( isolate );
+		v8::Local<v8::Context> context = m_pV8Context->m_Context.Get( isolate );
+		v8::Context::Scope context_scope( context );
+		LocalValue Value;
+		if( !m_pV8Context->DeserializeBuffer( pBuffer, nSize, Value ) )
+			return false;
+		return context->Global()->Set( context, 
+			v8::String::NewFromUtf8( isolate, szName ), Value ).FromMaybe( false );
+	}
+
 	SCallInfo* CScriptJS::GetCallInfo( const CCallInfo* pCallBase )
 	{
 		v8::Isolate* isolate = GetV8Context().m_pIsolate;
@@ -395,11 +532,30 @@ namespace XS
 		Context.ReportException( &try_catch, context );
 	}
 
+	void CScriptJS::InsertObjectInfo( SObjInfo* pObjectInfo )
+	{
+		m_mapObjInfo.Insert( *pObjectInfo );
+		m_hashObjInfo[pObjectInfo->m_pObject] = pObjectInfo;
+	}
+
+	void CScriptJS::RemoveObjectInfo( SObjInfo* pObjectInfo )
+	{
+		pObjectInfo->Remove();
+		CObjInfoHashMap::iterator it = m_hashObjInfo.find( pObjectInfo->m_pObject );
+		if( it != m_hashObjInfo.end() && it->second == pObjectInfo )
+			m_hashObjInfo.erase( it );
+	}
+
 	SObjInfo* CScriptJS::FindExistObjInfo( void* pObj )
 	{
 		if( pObj == NULL )
 			return NULL;
 
+		// 绝大多数查找都是对象首地址，先查哈希表，内部指针才走红黑树的区间查找
+		CObjInfoHashMap::iterator it = m_hashObjInfo.find( pObj );
+		if( it != m_hashObjInfo.end() )
+			return it->second;
+
 		SObjInfo* pRight = m_mapObjInfo.UpperBound( pObj );
 		if( pRight == m_mapObjInfo.GetFirst() )
 			return NULL;
@@ -435,19 +591,33 @@ namespace XS
 		v8::Local<v8::Context> context = Context.m_Context.Get( isolate );
 		v8::Context::Scope context_scope(context);
 
-		// Create a string containing the JavaScript source code.
-		v8::Local<v8::String> source = v8::String::NewFromUtf8( 
-			isolate, (const char*)pBuffer, v8::NewStringType::kNormal, (uint32)nSize )
-			.ToLocalChecked();
-
-		// Compile the source code.
-		v8::MaybeLocal<v8::String> fileName = v8::String::NewFromUtf8(
-			isolate, sFileName.c_str(), v8::NewStringType::kNormal );
-		v8::ScriptOrigin origin(fileName.ToLocalChecked());
-		auto temp_script = v8::Script::Compile(context, source, &origin);
-		if( temp_script.IsEmpty() )
-			return false;
-		v8::Local<v8::Script> script = temp_script.ToLocalChecked();
+		// RunString的代码块编译后缓存，由CScriptBase的LRU决定何时释放
+		v8::Local<v8::Script> script;
+		bool bStringChunk = !strncmp( szFileName, 
+			s_CacheTruckPrefix.c_str(), s_CacheTruckPrefix.size() );
+		auto itChunk = Context.m_mapChunkCache.find( szFileName );
+		if( itChunk != Context.m_mapChunkCache.end() )
+		{
+			script = itChunk->second.Get( isolate )->BindToCurrentContext();
+		}
+		else
+		{
+			// Create a string containing the JavaScript source code.
+			v8::Local<v8::String> source = v8::String::NewFromUtf8( 
+				isolate, (const char*)pBuffer, v8::NewStringType::kNormal, (uint32)nSize )
+				.ToLocalChecked();
+
+			// Compile the source code.
+			v8::MaybeLocal<v8::String> fileName = v8::String::NewFromUtf8(
+				isolate, sFileName.c_str(), v8::NewStringType::kNormal );
+			v8::ScriptOrigin origin(fileName.ToLocalChecked());
+			auto temp_script = v8::Script::Compile(context, source, &origin);
+			if( temp_script.IsEmpty() )
+				return false;
+			script = temp_script.ToLocalChecked();
+			if( bStringChunk )
+				Context.m_mapChunkCache[szFileName].Reset( isolate, script->GetUnboundScript() );
+		}
 		auto scriptInfo = script->GetUnboundScript();
 		int32 nID = scriptInfo->GetId();
 
@@ -464,6 +634,16 @@ namespace XS
 		return true;
 	}
 
+	void CScriptJS::ReleaseChunk( const char* szChunkName )
+	{
+		SV8Context& Context = GetV8Context();
+		auto itChunk = Context.m_mapChunkCache.find( szChunkName );
+		if( itChunk == Context.m_mapChunkCache.end() )
+			return;
+		itChunk->second.Reset();
+		Context.m_mapChunkCache.erase( itChunk );
+	}
+
 	bool CScriptJS::RunFunction( const STypeInfoArray& aryTypeInfo, 
 		void* pResultBuf, const char* szFunction, void** aryArg )
 	{
@@ -520,96 +700,126 @@ namespace XS
 		return true;
 	}
 
-	void CScriptJS::BuildRegisterInfo()
+	SJSClassInfo* CScriptJS::BindClass( const CClassInfo* pInfo )
 	{
+		SJSClassInfo* classInfo = m_mapClassInfo.Find( (const void*)pInfo );
+		if( classInfo != nullptr )
+			return classInfo;
+
 		SV8Context& Context = GetV8Context();
 		v8::Isolate* isolate = Context.m_pIsolate;
-		std::function<void( const CClassInfo*,
-			v8::Local<v8::Function>, v8::Local<v8::Object>, bool )> MakeMeberFunction;
+		v8::HandleScope handle_scope( isolate );
+		v8::Local<v8::Context> context = Context.m_Context.Get( isolate );
+		v8::Context::Scope context_scope( context );
+		v8::Local<v8::Object> globalObj = context->Global();
+
+		// 基类必须先于子类绑定，子类模板从基类模板继承
+		v8::Local<v8::FunctionTemplate> BaseTemplate;
+		LocalValue Base = Undefined( isolate );
+		if( pInfo->BaseRegist().size() )
+		{
+			SJSClassInfo* baseInfo = BindClass( pInfo->BaseRegist()[0].m_pBaseInfo );
+			assert( baseInfo != nullptr );
+			BaseTemplate = baseInfo->m_FunctionTemplate.Get( isolate );
+			Base = BaseTemplate->GetFunction( context ).ToLocalChecked();
+		}
 
-		MakeMeberFunction = [&]( const CClassInfo* pInfo,
-			v8::Local<v8::Function> NewClass, v8::Local<v8::Object> Prototype, bool bBase )->void
+		// 先插入，绑定过程中再次访问此类时直接返回
+		classInfo = new SJSClassInfo;
+		classInfo->m_pScript = this;
+		classInfo->m_pClassInfo = pInfo;
+		const char* szClass = pInfo->GetClassName().c_str();
+		v8::Local<v8::String> strClassName = v8::String::NewFromUtf8( isolate, szClass );
+		v8::Local<v8::External> ClassValue = v8::External::New( isolate, classInfo );
+		v8::Local<v8::FunctionTemplate> NewTemplate = v8::FunctionTemplate::New(
+			isolate, &SV8Context::NewObject, ClassValue );
+		NewTemplate->SetClassName( strClassName );
+		NewTemplate->InstanceTemplate()->SetInternalFieldCount( eBindField_Count );
+		if( !BaseTemplate.IsEmpty() )
+			NewTemplate->Inherit( BaseTemplate );
+		classInfo->m_FunctionTemplate.Reset( isolate, NewTemplate );
+		m_mapClassInfo.Insert( *classInfo );
+
+		// 成员函数和成员变量都挂在模板上，带上接收者签名
+		// V8自己检查this的类型，调用点也可以被优化器内联
+		v8::Local<v8::ObjectTemplate> PrototypeTemplate = NewTemplate->PrototypeTemplate();
+		v8::Local<v8::Signature> Signature = v8::Signature::New( isolate, NewTemplate );
+		v8::Local<v8::AccessorSignature> AccessorSignature = 
+			v8::AccessorSignature::New( isolate, NewTemplate );
+		std::function<void( const CClassInfo*, bool )> MakeMeberFunction;
+		MakeMeberFunction = [&]( const CClassInfo* pInfo, bool bBase )->void
 		{
-			v8::Local<v8::Context> context = isolate->GetCurrentContext();
 			const CCallBaseMap& mapFunction = pInfo->GetRegistFunction();
-			std::string strName = pInfo->GetClassName().c_str();
 			for( auto pCall = mapFunction.GetFirst(); pCall; pCall = pCall->GetNext() )
 			{
-				const char* szFunName = pCall->GetFunctionName().c_str();
+				v8::Local<v8::String> strName = 
+					v8::String::NewFromUtf8( isolate, pCall->GetFunctionName().c_str() );
+				v8::Local<v8::External> CallValue = v8::External::New( isolate, GetCallInfo( pCall ) );
 				if( pCall->GetFunctionIndex() == eCT_MemberFunction )
 				{
-					Prototype->SetAccessor( context, 
-						v8::String::NewFromUtf8( isolate, szFunName ),
+					// 必须是真正的访问器，原型上的native data property被赋值时会在实例上生成同名属性
+					PrototypeTemplate->SetAccessor( strName, 
 						&SV8Context::GetterFromV8, &SV8Context::SetterFromV8,
-						v8::External::New( isolate, GetCallInfo( pCall ) ) );
+						CallValue, v8::DEFAULT, v8::None, AccessorSignature );
 				}
 				else if( pCall->GetFunctionIndex() == eCT_ClassStaticFunction )
 				{
-					NewClass->Set( context, 
-						v8::String::NewFromUtf8( isolate, szFunName ),
-						v8::Function::New( isolate, &SV8Context::CallFromV8,
-						v8::External::New( isolate, GetCallInfo( pCall ) ) ) );
+					NewTemplate->Set( strName, v8::FunctionTemplate::New( 
+						isolate, &SV8Context::CallFromV8, CallValue ) );
 				}
 				else
 				{
-					Prototype->Set( context, 
-						v8::String::NewFromUtf8( isolate, szFunName ),
-						v8::Function::New( isolate, &SV8Context::CallFromV8,
-						v8::External::New( isolate, GetCallInfo( pCall ) ) ) );
+					PrototypeTemplate->Set( strName, v8::FunctionTemplate::New( 
+						isolate, &SV8Context::CallFromV8, CallValue, Signature ) );
 				}
 			}
 			if( !bBase )
 				return;
 			for( uint32 i = 0; i < pInfo->BaseRegist().size(); i++ )
-				MakeMeberFunction( pInfo->BaseRegist()[i].m_pBaseInfo, NewClass, Prototype, true );
+				MakeMeberFunction( pInfo->BaseRegist()[i].m_pBaseInfo, true );
 		};
 
-		auto CheckClassInfo = [this]( const CClassInfo* pInfo, 
-			v8::Isolate* isolate, v8::Local<v8::Context> context )->SJSClassInfo*
+		// 第一个基类通过Inherit继承，其余基类的函数直接展开到本类
+		for( uint32 i = 1; i < pInfo->BaseRegist().size(); i++ )
+			MakeMeberFunction( pInfo->BaseRegist()[i].m_pBaseInfo, true );
+		MakeMeberFunction( pInfo, false );
+		PrototypeTemplate->Set( Context.m_Deconstruction.Get( isolate ), 
+			v8::FunctionTemplate::New( isolate, &SV8Context::Destruction, ClassValue, Signature ) );
+		if( pInfo->IsTableConvert() )
 		{
-			SJSClassInfo* classInfo = m_mapClassInfo.Find( (const void*)pInfo );
-			if( classInfo != nullptr )
-				return classInfo;
-
-			classInfo = new SJSClassInfo;
-			classInfo->m_pScript = this;
-			classInfo->m_pClassInfo = pInfo;
-			const char* szClass = pInfo->GetClassName().c_str();
-			v8::Local<v8::String> strClassName = v8::String::NewFromUtf8( isolate, szClass );
-			v8::Local<v8::FunctionTemplate> NewTemplate = v8::FunctionTemplate::New(
-				isolate, &SV8Context::NewObject, v8::External::New( isolate, classInfo ) );
-			NewTemplate->SetClassName( strClassName );
-			NewTemplate->InstanceTemplate()->SetInternalFieldCount( 1 );
-			PersistentFunTmplt& persistentTemplate = classInfo->m_FunctionTemplate;
-			persistentTemplate.Reset( isolate, NewTemplate );
-			m_mapClassInfo.Insert( *classInfo );
-			return classInfo;
-		};
+			PrototypeTemplate->Set( v8::String::NewFromUtf8( isolate, "ToTable" ),
+				v8::FunctionTemplate::New( isolate, &SV8Context::ToTable, ClassValue, Signature ) );
+			PrototypeTemplate->Set( v8::String::NewFromUtf8( isolate, "FromTable" ),
+				v8::FunctionTemplate::New( isolate, &SV8Context::FromTable, ClassValue, Signature ) );
+		}
 
+		// 模板在第一次GetFunction时实例化，之后不能再修改
+		v8::Local<v8::Function> NewClass = NewTemplate->GetFunction( context ).ToLocalChecked();
+		v8::Local<v8::Function> XSClass = Context.m_XSClass.Get( isolate );
+		v8::Local<v8::String> strPathName = v8::String::NewFromUtf8( isolate, szClass );
+		LocalValue args[] = { NewClass, strPathName, Base };
+		XSClass->Call( globalObj, 3, args );
+		return classInfo;
+	}
+
+	void CScriptJS::BuildRegisterInfo()
+	{
+		SV8Context& Context = GetV8Context();
+		v8::Isolate* isolate = Context.m_pIsolate;
 		const CTypeIDNameMap& mapRegisterInfo = CClassInfo::GetAllRegisterInfo();
 		for( auto pInfo = mapRegisterInfo.GetFirst(); pInfo; pInfo = pInfo->GetNext() )
 		{
 			if( pInfo->IsEnum() )
 				continue;
 
-			if( pInfo->GetTypeIDName().empty() )
+			// 类只按顶层包名记录，第一次被脚本访问或者对象被传入脚本时才绑定
+			if( !pInfo->GetTypeIDName().empty() )
 			{
-				v8::HandleScope handle_scope( isolate );
-				v8::Local<v8::Context> context = Context.m_Context.Get( isolate );
-				v8::Context::Scope context_scope( context );
-				v8::Local<v8::Object> globalObj = context->Global();
-				v8::Local<v8::String> strPackage = v8::String::NewFromUtf8( isolate, "window" );
-				LocalValue Package = globalObj->Get( strPackage );
-				assert( !Package.IsEmpty() );
-				const CCallBaseMap& mapFunction = pInfo->GetRegistFunction();
-				for( auto pCall = mapFunction.GetFirst(); pCall; pCall = pCall->GetNext() )
-				{
-					v8::Local<v8::Function> funGlobal = v8::Function::New( isolate,
-						&SV8Context::CallFromV8, v8::External::New( isolate, GetCallInfo(pCall) ) );
-					const char* szFunName = pCall->GetFunctionName().c_str();
-					Package->ToObject( isolate )->Set(
-						v8::String::NewFromUtf8( isolate, szFunName ), funGlobal );
-				}
+				std::string strPath = pInfo->GetClassName().c_str();
+				if( strPath.empty() )
+					continue;
+				std::string strPackage = strPath.substr( 0, strPath.find( '.' ) );
+				m_mapClassPackage[strPackage].push_back( pInfo );
 				continue;
 			}
 
@@ -617,39 +827,18 @@ namespace XS
 			v8::Local<v8::Context> context = Context.m_Context.Get( isolate );
 			v8::Context::Scope context_scope( context );
 			v8::Local<v8::Object> globalObj = context->Global();
-			SJSClassInfo* classInfo = CheckClassInfo( pInfo, isolate, context );
-			assert( classInfo != nullptr );
-
-			const char* szClass = pInfo->GetClassName().c_str();
-			PersistentFunTmplt& persistentTemplate = classInfo->m_FunctionTemplate;
-			v8::Local<v8::FunctionTemplate> NewTemplate = persistentTemplate.Get( isolate );
-			v8::Local<v8::Function> NewClass = NewTemplate->GetFunction( context ).ToLocalChecked();
-
-			LocalValue Base = Undefined( isolate );
-			if( pInfo->BaseRegist().size() )
+			v8::Local<v8::String> strPackage = v8::String::NewFromUtf8( isolate, "window" );
+			LocalValue Package = globalObj->Get( strPackage );
+			assert( !Package.IsEmpty() );
+			const CCallBaseMap& mapFunction = pInfo->GetRegistFunction();
+			for( auto pCall = mapFunction.GetFirst(); pCall; pCall = pCall->GetNext() )
 			{
-				const CClassInfo* pBaseInfo = pInfo->BaseRegist()[0].m_pBaseInfo;
-				SJSClassInfo* classInfo = CheckClassInfo( pBaseInfo, isolate, context );
-				assert( classInfo != nullptr );
-				PersistentFunTmplt& persistentTemplate = classInfo->m_FunctionTemplate;
-				v8::Local<v8::FunctionTemplate> BaseTemplate = persistentTemplate.Get( isolate );
-				Base = BaseTemplate->GetFunction( context ).ToLocalChecked();
+				v8::Local<v8::Function> funGlobal = v8::Function::New( isolate,
+					&SV8Context::CallFromV8, v8::External::New( isolate, GetCallInfo(pCall) ) );
+				const char* szFunName = pCall->GetFunctionName().c_str();
+				Package->ToObject( isolate )->Set(
+					v8::String::NewFromUtf8( isolate, szFunName ), funGlobal );
 			}
-
-			std::string strNewPath = szClass;
-			v8::Local<v8::Function> XSClass = Context.m_XSClass.Get( isolate );
-			v8::Local<v8::String> strPathName = v8::String::NewFromUtf8( isolate, strNewPath.c_str() );
-			LocalValue args[] = { NewClass, strPathName, Base };
-			XSClass->Call( globalObj, 3, args );
-
-			v8::MaybeLocal<v8::Value> Prototype = NewClass->Get( context, Context.m_Prototype.Get( isolate ) );
-			v8::Local<v8::Object> PrototypeObj = Prototype.ToLocalChecked()->ToObject( isolate );
-			v8::Local<v8::Value> InfoValue = v8::External::New( isolate, pInfo );
-			PrototypeObj->Set( context, Context.m_Deconstruction.Get( isolate ),
-				v8::Function::New( isolate, &SV8Context::Destruction, InfoValue ) );
-			for( uint32 i = 1; i < pInfo->BaseRegist().size(); i++ )
-				MakeMeberFunction( pInfo->BaseRegist()[i].m_pBaseInfo, NewClass, PrototypeObj, true );
-			MakeMeberFunction( pInfo, NewClass, PrototypeObj, false );
 		}
 	}
 
@@ -664,10 +853,139 @@ namespace XS
 		if( !pObjInfo )
 			return;
 		// 这里仅仅解除绑定
-		pObjInfo->Remove();
+		AddObjectStat( pObjInfo->m_pClassInfo->m_pClassInfo, 
+			(EObjectStat)pObjInfo->m_nObjectStat, -1 );
+		RemoveObjectInfo( pObjInfo );
 		pObjInfo->m_pObject = NULL;
 	}
 
+	static void WriteProfileString( FILE* fp, const char* szStr )
+	{
+		fputc( '"', fp );
+		for( const char* pCur = szStr ? szStr : ""; *pCur; pCur++ )
+		{
+			if( *pCur == '"' || *pCur == '\\' )
+				fprintf( fp, "\\%c", *pCur );
+			else if( (uint8)*pCur < 0x20 )
+				fprintf( fp, "\\u%04x", (uint8)*pCur );
+			else
+				fputc( *pCur, fp );
+		}
+		fputc( '"', fp );
+	}
+
+	static void WriteProfileNode( FILE* fp, const v8::CpuProfileNode* pNode, bool bFirst )
+	{
+		// callFrame中的行列号从0开始，V8返回的从1开始
+		fprintf( fp, "%s{\"id\":%u,\"callFrame\":{\"functionName\":", 
+			bFirst ? "" : ",", pNode->GetNodeId() );
+		WriteProfileString( fp, pNode->GetFunctionNameStr() );
+		fprintf( fp, ",\"scriptId\":\"%d\",\"url\":", pNode->GetScriptId() );
+		WriteProfileString( fp, pNode->GetScriptResourceNameStr() );
+		fprintf( fp, ",\"lineNumber\":%d,\"columnNumber\":%d},\"hitCount\":%u,\"children\":[",
+			pNode->GetLineNumber() - 1, pNode->GetColumnNumber() - 1, pNode->GetHitCount() );
+		int32 nCount = pNode->GetChildrenCount();
+		for( int32 i = 0; i < nCount; i++ )
+			fprintf( fp, i ? ",%u" : "%u", pNode->GetChild( i )->GetNodeId() );
+		fprintf( fp, "]}" );
+		for( int32 i = 0; i < nCount; i++ )
+			WriteProfileNode( fp, pNode->GetChild( i ), false );
+	}
+
+	bool CScriptJS::StartProfile( uint32 nSampleIntervalUs )
+	{
+		SV8Context& Context = GetV8Context();
+		if( Context.m_pCpuProfiler )
+			return false;
+		v8::Isolate* isolate = Context.m_pIsolate;
+		v8::HandleScope handle_scope( isolate );
+		Context.m_pCpuProfiler = v8::CpuProfiler::New( isolate );
+		Context.m_pCpuProfiler->SetSamplingInterval( (int)nSampleIntervalUs );
+		Context.m_pCpuProfiler->StartProfiling( v8::String::Empty( isolate ), true );
+		return true;
+	}
+
+	bool CScriptJS::StopProfile( const char* szFileName )
+	{
+		SV8Context& Context = GetV8Context();
+		if( !Context.m_pCpuProfiler )
+			return false;
+		v8::Isolate* isolate = Context.m_pIsolate;
+		v8::HandleScope handle_scope( isolate );
+		v8::CpuProfile* pProfile = 
+			Context.m_pCpuProfiler->StopProfiling( v8::String::Empty( isolate ) );
+		FILE* fp = pProfile && szFileName ? fopen( szFileName, "wb" ) : NULL;
+		if( fp )
+		{
+			fprintf( fp, "{\"nodes\":[" );
+			WriteProfileNode( fp, pProfile->GetTopDownRoot(), true );
+			fprintf( fp, "],\"startTime\":%lld,\"endTime\":%lld,\"samples\":[",
+				(long long)pProfile->GetStartTime(), (long long)pProfile->GetEndTime() );
+			int32 nSamples = pProfile->GetSamplesCount();
+			for( int32 i = 0; i < nSamples; i++ )
+				fprintf( fp, i ? ",%u" : "%u", pProfile->GetSample( i )->GetNodeId() );
+			fprintf( fp, "],\"timeDeltas\":[" );
+			int64 nPreTime = pProfile->GetStartTime();
+			for( int32 i = 0; i < nSamples; i++ )
+			{
+				int64 nTime = pProfile->GetSampleTimestamp( i );
+				fprintf( fp, i ? ",%lld" : "%lld", (long long)( nTime - nPreTime ) );
+				nPreTime = nTime;
+			}
+			fprintf( fp, "]}" );
+			fclose( fp );
+		}
+
+		if( pProfile )
+			pProfile->Delete();
+		Context.m_pCpuProfiler->Dispose();
+		Context.m_pCpuProfiler = nullptr;
+		return fp != NULL;
+	}
+
+	void CScriptJS::BeginBudget()
+	{
+		GetV8Context().StartWatchdog( m_tBudgetDeadline );
+	}
+
+	void CScriptJS::EndBudget()
+	{
+		// 被看门狗终止后要恢复，虚拟机才能继续使用
+		SV8Context& Context = GetV8Context();
+		if( !Context.StopWatchdog() )
+			return;
+		m_bBudgetExceeded = true;
+		Context.m_pIsolate->CancelTerminateExecution();
+	}
+
+	void CScriptJS::CallReloadHook( const char* szName )
+	{
+		SV8Context& Context = GetV8Context();
+		v8::Isolate* isolate = Context.m_pIsolate;
+		v8::HandleScope handle_scope( isolate );
+		v8::TryCatch try_catch( isolate );
+		v8::Local<v8::Context> context = Context.m_Context.Get( isolate );
+		v8::Context::Scope context_scope( context );
+		v8::Local<v8::Object> nsXS = Context.m_XSNameSpace.Get( isolate );
+		LocalValue funHook;
+		if( !nsXS->Get( context, v8::String::NewFromUtf8( isolate, szName ) ).ToLocal( &funHook ) )
+			return Context.ReportException( &try_catch, context );
+		if( !funHook->IsFunction() )
+			return;
+		if( v8::Local<v8::Function>::Cast( funHook )->Call( context, nsXS, 0, nullptr ).IsEmpty() )
+			Context.ReportException( &try_catch, context );
+	}
+
+	void CScriptJS::BeginReload()
+	{
+		CallReloadHook( "__reloadBegin" );
+	}
+
+	void CScriptJS::EndReload()
+	{
+		CallReloadHook( "__reloadEnd" );
+	}
+
 	void CScriptJS::GC()
 	{
 		GetV8Context().m_pIsolate->LowMemoryNotification();
@@ -7,6 +7,7 @@
 
 #ifndef __SCRIPT_JS_H__
 #define __SCRIPT_JS_H__
+#include <unordered_map>
 #include "common/TRBTree.h"
 #include "core/CScriptBase.h"
 
@@ -19,20 +20,34 @@ namespace XS
 
     class CScriptJS : public CScriptBase
 	{	
+		typedef std::vector<const CClassInfo*> CClassInfoArray;
+		typedef std::map<std::string, CClassInfoArray> CClassPackageMap;
+		typedef std::unordered_map<void*, SObjInfo*> CObjInfoHashMap;
+
 		SV8Context*					m_pV8Context;
 		SObjInfo*					m_pFreeObjectInfo;
 		TRBTree<SObjInfo>			m_mapObjInfo;
+		CObjInfoHashMap				m_hashObjInfo;
 		TRBTree<SJSClassInfo>		m_mapClassInfo;
 		TRBTree<SCallInfo>			m_mapCallBase;
+		CClassPackageMap			m_mapClassPackage;
 		
 		void						BuildRegisterInfo();
+		SJSClassInfo*				BindClass( const CClassInfo* pInfo );
 		
 		SCallInfo*					GetCallInfo( const CCallInfo* pCallBase );
 		SObjInfo*					AllocObjectInfo();
 		void						FreeObjectInfo(SObjInfo* pObjectInfo);
+		void						InsertObjectInfo(SObjInfo* pObjectInfo);
+		void						RemoveObjectInfo(SObjInfo* pObjectInfo);
 
 		virtual bool				CallVM( const CCallbackInfo* pCallBase, void* pRetBuf, void** pArgArray );
 		virtual void				DestrucVM( const CCallbackInfo* pCallBase, SVirtualObj* pObject );
+		virtual void				BeginBudget();
+		virtual void				EndBudget();
+		virtual void				BeginReload();
+		virtual void				EndReload();
+		void						CallReloadHook( const char* szName );
 
 		friend class CJSObject;
 		friend struct SV8Context;
@@ -44,10 +59,28 @@ namespace XS
 		SObjInfo*					FindExistObjInfo( void* pObj );
 							
 		virtual bool        		RunBuffer( const void* pBuffer, size_t nSize, const char* szFileName );
+		virtual void				ReleaseChunk( const char* szChunkName );
 		virtual bool        		RunFunction( const STypeInfoArray& aryTypeInfo, 
 										void* pResultBuf, const char* szFunction, void** aryArg );
 		
+		/**
+		 * @brief 进程内CPU采样，不需要inspector客户端
+		 *  StopProfile将结果以.cpuprofile格式写入szFileName，可用Chrome DevTools打开
+		 */
+		bool						StartProfile( uint32 nSampleIntervalUs = 1000 );
+		bool						StopProfile( const char* szFileName );
+
+		/**
+		 * @brief fork只能在单线程模式下进行，必须在创建第一个CScriptJS前调用
+		 *  V8不再使用后台线程编译和GC，子进程中不存在的平台线程也就不会被用到
+		 */
+		static bool					EnableForkMode();
+		virtual bool				PrepareFork();
+
 		virtual int32				Compiler( int32 nArgc, char** szArgv );
+		virtual bool				PublishSharedData( const char* szName, const CSharedData* pData );
+		virtual bool				SerializeGlobal( const char* szName, std::string& strBuffer );
+		virtual bool				DeserializeGlobal( const char* szName, const void* pBuffer, size_t nSize );
 		virtual void				UnlinkCppObjFromScript( void* pObj );
 
 		virtual void        		GC();
@@ -31,24 +31,8 @@ namespace XS
 			return NULL;
 		}
 
-		v8::Object* pScriptObject = v8::Object::Cast( *obj );
-		v8::External* pCppBind = NULL;
-		if( pScriptObject->InternalFieldCount() )
-			pCppBind = v8::External::Cast( *pScriptObject->GetInternalField( 0 ) );
-		else
-		{
-			v8::Local<v8::Value> key = Context.m_CppField.Get(isolate);
-			v8::Local<v8::Context> context = isolate->GetCurrentContext();
-			v8::MaybeLocal<v8::Value> field = pScriptObject->Get( context, key );
-			if( field.IsEmpty() )
-				return NULL;
-			v8::Local<v8::Value> extenalField = field.ToLocalChecked();
-			if( !extenalField->IsExternal() )
-				return NULL;
-			pCppBind = v8::External::Cast( *extenalField );
-		}
-
-		const SObjInfo* pInfo = ( const SObjInfo* )pCppBind->Value();
+		// 所有绑定对象（包括脚本派生类的实例）都把SObjInfo放在对齐指针内部字段里
+		const SObjInfo* pInfo = Context.GetObjInfo( v8::Object::Cast( *obj ) );
 		if( !pInfo || !pInfo->m_pObject )
 		{
 			*(void**)( pDataBuf ) = NULL;
@@ -86,17 +70,13 @@ namespace XS
 			pObjInfo->m_pClassInfo->m_pClassInfo->FindBase(pClassInfo) )
 			return pObjInfo->m_Object.Get( isolate );
 
-		static PersistentFunTmplt s_Instance;
-		SJSClassInfo* classInfo = Script.m_mapClassInfo.Find((const void*)pClassInfo);
-		PersistentFunTmplt& persistentTemplate = classInfo ? classInfo->m_FunctionTemplate : s_Instance;
+		SJSClassInfo* classInfo = Script.BindClass( pClassInfo );
+		PersistentFunTmplt& persistentTemplate = classInfo->m_FunctionTemplate;
 		v8::Local<v8::Context> context = isolate->GetCurrentContext();
 		v8::Local<v8::FunctionTemplate> funTemplate = persistentTemplate.Get(isolate);
-		v8::Local<v8::Function> JSClass = funTemplate->GetFunction(context).ToLocalChecked();
+		// 原型链由模板继承建立，实例直接带上类的prototype，不再修改__proto__
 		v8::Local<v8::ObjectTemplate> objTemplate = funTemplate->InstanceTemplate();
 		v8::Local<v8::Object> NewObj = objTemplate->NewInstance(context).ToLocalChecked();
-		v8::Local<v8::String> __proto__ = Context.m___proto__.Get(isolate);
-		v8::Local<v8::String> Prototype = Context.m_Prototype.Get(isolate);
-		NewObj->Set(context, __proto__, JSClass->Get(context, Prototype).ToLocalChecked() );
 
 		if( !bCopy )
 		{
@@ -106,7 +86,7 @@ namespace XS
 
 		void* pNewObject = new tbyte[pClassInfo->GetClassSize()];
 		pClassInfo->CopyConstruct( &Script, pNewObject, pObj );
-		Context.BindObj( pNewObject, NewObj, pClassInfo, true );
+		Context.BindObj( pNewObject, NewObj, pClassInfo, true, true );
 		return NewObj;
 	}
 
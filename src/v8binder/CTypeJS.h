@@ -15,12 +15,42 @@
 namespace XS
 {
 	#define MAX_UNKNOW_ARRAYBUFFER_SIZE	(100*1024*1024)
+	#define MAX_SAFE_INTEGER			9007199254740992LL
 
 	class CJSTypeBase;
 	//=====================================================================
 	/// aux function
 	//=====================================================================
 	CJSTypeBase* GetJSTypeBase( DataType eType );
+
+	/// 64位整数超过2^53时用BigInt，2^53以内仍然是Number
+	inline int64 GetInt64FromJS( CScriptJS& Script, LocalValue obj, bool bUnsigned )
+	{
+		double fValue;
+		if( obj->IsNumber() )
+			fValue = obj.As<v8::Number>()->Value();
+		else if( obj->IsBigInt() )
+			return bUnsigned ? (int64)obj.As<v8::BigInt>()->Uint64Value()
+				: obj.As<v8::BigInt>()->Int64Value();
+		else
+		{
+			v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
+			v8::Local<v8::Context> context = isolate->GetCurrentContext();
+			v8::MaybeLocal<v8::Number> v = obj->ToNumber(context);
+			fValue = v.IsEmpty() ? 0 : v.ToLocalChecked()->Value();
+		}
+		return fValue < 0 ? (int64)fValue : (int64)(uint64)fValue;
+	}
+
+	inline LocalValue NewInt64ToJS( v8::Isolate* isolate, int64 nValue, bool bUnsigned )
+	{
+		if( bUnsigned ? (uint64)nValue <= (uint64)MAX_SAFE_INTEGER
+			: ( nValue >= -MAX_SAFE_INTEGER && nValue <= MAX_SAFE_INTEGER ) )
+			return v8::Number::New( isolate, bUnsigned ? (double)(uint64)nValue : (double)nValue );
+		if( bUnsigned )
+			return v8::BigInt::NewFromUnsigned( isolate, (uint64)nValue );
+		return v8::BigInt::New( isolate, nValue );
+	}
 	
 	//=====================================================================
     /// Base class of data type
@@ -45,6 +75,12 @@ namespace XS
 		void FromVMValue(DataType eType, 
 			CScriptJS& Script, char* pDataBuf, LocalValue obj)
 		{
+			// 绝大部分整数参数是Smi，直接读取，不创建句柄也不取context
+			if( obj->IsInt32() )
+			{
+				*(T*)(pDataBuf) = (T)obj.As<v8::Int32>()->Value();
+				return;
+			}
 			v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
 			v8::Local<v8::Context> context = isolate->GetCurrentContext();
 			v8::MaybeLocal<v8::Int32> v = obj->ToInt32(context);
@@ -68,6 +104,11 @@ namespace XS
 	template<> inline void TJSValue<double>::FromVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf, LocalValue obj)
 	{
+		if( obj->IsNumber() )
+		{
+			*(double*)(pDataBuf) = obj.As<v8::Number>()->Value();
+			return;
+		}
 		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
 		v8::Local<v8::Context> context = isolate->GetCurrentContext();
 		v8::MaybeLocal<v8::Number> v = obj->ToNumber(context);
@@ -83,6 +124,11 @@ namespace XS
 	template<> inline void TJSValue<float>::FromVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf, LocalValue obj)
 	{
+		if( obj->IsNumber() )
+		{
+			*(float*)(pDataBuf) = (float)obj.As<v8::Number>()->Value();
+			return;
+		}
 		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
 		v8::Local<v8::Context> context = isolate->GetCurrentContext();
 		v8::MaybeLocal<v8::Number> v = obj->ToNumber(context);
@@ -98,70 +144,63 @@ namespace XS
 	template<> inline void TJSValue<uint64>::FromVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf, LocalValue obj)
 	{
-		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
-		v8::Local<v8::Context> context = isolate->GetCurrentContext();
-		v8::MaybeLocal<v8::Number> v = obj->ToNumber(context);
-		*(uint64*)(pDataBuf) = (uint64)( v.IsEmpty() ? 0 : v.ToLocalChecked()->Value() );
+		*(uint64*)(pDataBuf) = (uint64)GetInt64FromJS( Script, obj, true );
 	}
 
 	template<> inline LocalValue TJSValue<uint64>::ToVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf)
 	{
 		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
-		return v8::Number::New(isolate, (double)*(uint64*)(pDataBuf));
+		return NewInt64ToJS( isolate, (int64)*(uint64*)(pDataBuf), true );
 	}
 
 	template<> inline void TJSValue<ulong>::FromVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf, LocalValue obj)
 	{
-		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
-		v8::Local<v8::Context> context = isolate->GetCurrentContext();
-		v8::MaybeLocal<v8::Number> v = obj->ToNumber(context);
-		*(ulong*)(pDataBuf) = (ulong)( v.IsEmpty() ? 0 : v.ToLocalChecked()->Value() );
+		*(ulong*)(pDataBuf) = (ulong)GetInt64FromJS( Script, obj, true );
 	}
 
 	template<> inline LocalValue TJSValue<ulong>::ToVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf)
 	{
 		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
-		return v8::Number::New(isolate, (double)*(ulong*)(pDataBuf));
+		return NewInt64ToJS( isolate, (int64)(uint64)*(ulong*)(pDataBuf), true );
 	}
 
 	template<> inline void TJSValue<int64>::FromVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf, LocalValue obj)
 	{
-		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
-		v8::Local<v8::Context> context = isolate->GetCurrentContext();
-		v8::MaybeLocal<v8::Number> v = obj->ToNumber(context);
-		*(int64*)(pDataBuf) = (int64)( v.IsEmpty() ? 0 : v.ToLocalChecked()->Value() );
+		*(int64*)(pDataBuf) = GetInt64FromJS( Script, obj, false );
 	}
 
 	template<> inline LocalValue TJSValue<int64>::ToVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf)
 	{
 		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
-		return v8::Number::New(isolate, (double)*(int64*)(pDataBuf));
+		return NewInt64ToJS( isolate, *(int64*)(pDataBuf), false );
 	}
 
 	template<> inline void TJSValue<long>::FromVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf, LocalValue obj)
 	{
-		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
-		v8::Local<v8::Context> context = isolate->GetCurrentContext();
-		v8::MaybeLocal<v8::Number> v = obj->ToNumber(context);
-		*(long*)(pDataBuf) = (long)( v.IsEmpty() ? 0 : v.ToLocalChecked()->Value());
+		*(long*)(pDataBuf) = (long)GetInt64FromJS( Script, obj, false );
 	}
 
 	template<> inline LocalValue TJSValue<long>::ToVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf)
 	{
 		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
-		return v8::Number::New(isolate, *(long*)(pDataBuf));
+		return NewInt64ToJS( isolate, (int64)*(long*)(pDataBuf), false );
 	}
 
 	template<> inline void TJSValue<uint32>::FromVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf, LocalValue obj)
 	{
+		if( obj->IsUint32() )
+		{
+			*(uint32*)(pDataBuf) = obj.As<v8::Uint32>()->Value();
+			return;
+		}
 		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
 		v8::Local<v8::Context> context = isolate->GetCurrentContext();
 		v8::MaybeLocal<v8::Uint32> v = obj->ToUint32(context);
@@ -178,6 +217,11 @@ namespace XS
 	template<> inline void TJSValue<bool>::FromVMValue(
 		DataType eType, CScriptJS& Script, char* pDataBuf, LocalValue obj)
 	{
+		if( obj->IsBoolean() )
+		{
+			*(bool*)(pDataBuf) = obj.As<v8::Boolean>()->Value();
+			return;
+		}
 		v8::Isolate* isolate = Script.GetV8Context().m_pIsolate;
 		v8::Local<v8::Context> context = isolate->GetCurrentContext();
 		v8::MaybeLocal<v8::Boolean> v = obj->ToBoolean(context);
@@ -3,6 +3,9 @@
 #include "CDebugJS.h"
 #include "CTypeJS.h"
 #include "core/CCallInfo.h"
+#include "core/CSharedData.h"
+#include "core/CScriptSerial.h"
+#include "common/UtfConvert.h"
 
 #define MAX_STRING_BUFFER_SIZE	65536
 
@@ -16,9 +19,69 @@ namespace XS
 		, m_pTempStrBuffer64K(new tbyte[MAX_STRING_BUFFER_SIZE])
 		, m_nCurUseSize(0)
 		, m_nStrBufferStack(0)
+		, m_pCpuProfiler(nullptr)
+		, m_bWatchdogArmed(false)
+		, m_bWatchdogQuit(false)
+		, m_bWatchdogFired(false)
 	{
 	}
 
+	void SV8Context::StartWatchdog( std::chrono::steady_clock::time_point tDeadline )
+	{
+		std::lock_guard<std::mutex> Lock( m_hWatchdogLock );
+		if( !m_hWatchdog.joinable() )
+		{
+			// 线程在fork前被停掉后会在这里重新启动
+			m_bWatchdogQuit = false;
+			struct _{  static void Run( SV8Context* pThis ) { pThis->WatchdogRun(); } };
+			m_hWatchdog = std::thread( &_::Run, this );
+		}
+		m_tWatchdogDeadline = tDeadline;
+		m_bWatchdogArmed = true;
+		m_bWatchdogFired = false;
+		m_hWatchdogSignal.notify_all();
+	}
+
+	bool SV8Context::StopWatchdog()
+	{
+		// 在锁内取消，保证返回后不会再被终止
+		std::lock_guard<std::mutex> Lock( m_hWatchdogLock );
+		m_bWatchdogArmed = false;
+		m_hWatchdogSignal.notify_all();
+		return m_bWatchdogFired;
+	}
+
+	void SV8Context::ShutdownWatchdog()
+	{
+		{
+			std::lock_guard<std::mutex> Lock( m_hWatchdogLock );
+			m_bWatchdogQuit = true;
+			m_bWatchdogArmed = false;
+		}
+		m_hWatchdogSignal.notify_all();
+		if( m_hWatchdog.joinable() )
+			m_hWatchdog.join();
+	}
+
+	void SV8Context::WatchdogRun()
+	{
+		std::unique_lock<std::mutex> Lock( m_hWatchdogLock );
+		while( !m_bWatchdogQuit )
+		{
+			if( !m_bWatchdogArmed )
+			{
+				m_hWatchdogSignal.wait( Lock );
+				continue;
+			}
+			m_hWatchdogSignal.wait_until( Lock, m_tWatchdogDeadline );
+			if( !m_bWatchdogArmed || std::chrono::steady_clock::now() < m_tWatchdogDeadline )
+				continue;
+			m_bWatchdogArmed = false;
+			m_bWatchdogFired = true;
+			m_pIsolate->TerminateExecution();
+		}
+	}
+
 	void SV8Context::CallJSStatck(bool bAdd)
 	{
 		if (bAdd)
@@ -68,12 +131,10 @@ namespace XS
 		if (sizeof(wchar_t) == sizeof(uint16_t))
 			return v8::String::NewFromTwoByte(m_pIsolate,
 			(uint16_t*)szUcs, v8::NewStringType::kNormal).ToLocalChecked();
-		m_szTempUcs2 = szUcs;
-		size_t nSize = m_szTempUcs2.size();
+		size_t nSize = wcslen(szUcs);
+		m_szTempUcs2.resize(nSize + 1);
 		uint16_t* szDes = (uint16_t*)&m_szTempUcs2[0];
-		for (size_t i = 0; i < nSize; i++)
-			szDes[i] = m_szTempUcs2[i];
-		szDes[nSize] = 0;
+		UcsToUtf16((uint16*)szDes, szUcs, nSize);
 		return v8::String::NewFromTwoByte(m_pIsolate,
 			(uint16_t*)szDes, v8::NewStringType::kNormal).ToLocalChecked();
 	}
@@ -123,7 +184,7 @@ namespace XS
 		if (v.IsEmpty())
 			return NULL;
 		v8::Local<v8::String> StringObject = v.ToLocalChecked();
-		size_t nStrLen = StringObject->Utf8Length(m_pIsolate);
+		size_t nStrLen = StringObject->Length();
 		if (nStrLen == 0)
 			return L"";
 
@@ -132,8 +193,6 @@ namespace XS
 		if (nAllocSize + m_nCurUseSize < MAX_STRING_BUFFER_SIZE)
 		{
 			szUcs2 = (wchar_t*)(m_pTempStrBuffer64K + m_nCurUseSize);
-			StringObject->Write(m_pIsolate, (uint16_t*)szUcs2);
-			szUcs2[nStrLen] = 0;
 			SStringFixed strCpp;
 			strCpp.m_pStack = &strCpp;
 			strCpp.m_nLen = nAllocSize;
@@ -145,15 +204,19 @@ namespace XS
 			SStringDynamic strCpp;
 			strCpp.m_pStack = &strCpp;
 			strCpp.m_pBuffer = szUcs2 = new wchar_t[nStrLen + 1];
-			StringObject->Write(m_pIsolate, (uint16_t*)szUcs2);
 			m_vecStringInfo.push_back(strCpp);
 		}
 
 		if (sizeof(wchar_t) == sizeof(uint16_t))
+		{
+			StringObject->Write(m_pIsolate, (uint16_t*)szUcs2);
 			return szUcs2;
-		uint16_t* szSrc = (uint16_t*)szUcs2;
-		while (nStrLen--)
-			szUcs2[nStrLen] = szSrc[nStrLen];
+		}
+
+		// wchar_t为4字节时，utf16先写到缓冲区的后半部分，再原地展开
+		uint16_t* szUtf16 = (uint16_t*)szUcs2 + nStrLen + 1;
+		StringObject->Write(m_pIsolate, szUtf16);
+		Utf16ToUcs(szUcs2, (const uint16*)szUtf16, nStrLen);
 		return szUcs2;
 	}
 
@@ -161,6 +224,547 @@ namespace XS
 	//==================================================================================================================================//
 	//                                                        对内部提供的功能性函数                                                    //
 	//==================================================================================================================================//
+	//=====================================================================
+	// 只读共享数据，对象只持有节点指针，不复制容器
+	//=====================================================================
+	LocalValue SV8Context::NewSharedData( const CSharedData* pData )
+	{
+		if( !pData )
+			return v8::Undefined( m_pIsolate );
+		switch( pData->GetType() )
+		{
+		case CSharedData::eType_Bool:
+			return v8::Boolean::New( m_pIsolate, pData->GetBool() );
+		case CSharedData::eType_Number:
+			return v8::Number::New( m_pIsolate, pData->GetNumber() );
+		case CSharedData::eType_String:
+			return v8::String::NewFromUtf8( m_pIsolate, pData->GetString(), 
+				v8::NewStringType::kNormal, (int)pData->GetStringSize() ).ToLocalChecked();
+		case CSharedData::eType_Array:
+		case CSharedData::eType_Map:
+			break;
+		default:
+			return v8::Null( m_pIsolate );
+		}
+
+		auto it = m_mapSharedData.find( pData );
+		if( it != m_mapSharedData.end() )
+			return v8::Local<v8::Object>::New( m_pIsolate, it->second );
+
+		if( m_SharedDataTemplate.IsEmpty() )
+		{
+			v8::Local<v8::External> Self = v8::External::New( m_pIsolate, this );
+			v8::Local<v8::ObjectTemplate> Template = v8::ObjectTemplate::New( m_pIsolate );
+			Template->SetInternalFieldCount( 1 );
+			Template->SetHandler( v8::NamedPropertyHandlerConfiguration( 
+				&SV8Context::SharedNamedGetter, &SV8Context::SharedNamedSetter, nullptr, 
+				&SV8Context::SharedNamedDeleter, &SV8Context::SharedNamedEnumerator, Self, 
+				v8::PropertyHandlerFlags::kOnlyInterceptStrings ) );
+			Template->SetHandler( v8::IndexedPropertyHandlerConfiguration( 
+				&SV8Context::SharedIndexedGetter, &SV8Context::SharedIndexedSetter, nullptr, 
+				&SV8Context::SharedIndexedDeleter, &SV8Context::SharedIndexedEnumerator, Self ) );
+			m_SharedDataTemplate.Reset( m_pIsolate, Template );
+		}
+
+		v8::Local<v8::Context> context = m_pIsolate->GetCurrentContext();
+		v8::Local<v8::ObjectTemplate> Template = 
+			v8::Local<v8::ObjectTemplate>::New( m_pIsolate, m_SharedDataTemplate );
+		v8::Local<v8::Object> Object = Template->NewInstance( context ).ToLocalChecked();
+		Object->SetAlignedPointerInInternalField( 0, (void*)pData );
+		// 弱引用缓存，脚本不再引用时随对象一起回收
+		PersistentObject& Cache = m_mapSharedData[pData];
+		Cache.Reset( m_pIsolate, Object );
+		Cache.SetWeak( this, &SV8Context::SharedDataGCCallback, 
+			v8::WeakCallbackType::kInternalFields );
+		return Object;
+	}
+
+	void SV8Context::SharedDataGCCallback( const v8::WeakCallbackInfo<SV8Context>& data )
+	{
+		SV8Context* pContext = data.GetParameter();
+		auto it = pContext->m_mapSharedData.find( (const CSharedData*)data.GetInternalField( 0 ) );
+		if( it == pContext->m_mapSharedData.end() )
+			return;
+		it->second.Reset();
+		pContext->m_mapSharedData.erase( it );
+	}
+
+	void SV8Context::ClearSharedData()
+	{
+		for( auto it = m_mapSharedData.begin(); it != m_mapSharedData.end(); ++it )
+			it->second.Reset();
+		m_mapSharedData.clear();
+		m_SharedDataTemplate.Reset();
+	}
+
+	static const CSharedData* GetSharedData( v8::Local<v8::Object> Holder )
+	{
+		return (const CSharedData*)Holder->GetAlignedPointerFromInternalField( 0 );
+	}
+
+	static SV8Context* GetSharedContext( v8::Local<v8::Value> Data )
+	{
+		return (SV8Context*)v8::Local<v8::External>::Cast( Data )->Value();
+	}
+
+	static void ThrowReadOnly( v8::Isolate* isolate )
+	{
+		isolate->ThrowException( v8::Exception::TypeError( 
+			v8::String::NewFromUtf8( isolate, "shared data is read only" ) ) );
+	}
+
+	void SV8Context::SharedNamedGetter( v8::Local<v8::Name> property, 
+		const v8::PropertyCallbackInfo<v8::Value>& info )
+	{
+		const CSharedData* pData = GetSharedData( info.Holder() );
+		SV8Context* pContext = GetSharedContext( info.Data() );
+		v8::String::Utf8Value strName( info.GetIsolate(), property );
+		if( !*strName )
+			return;
+		if( pData->GetType() == CSharedData::eType_Array )
+		{
+			if( strcmp( *strName, "length" ) == 0 )
+				info.GetReturnValue().Set( pData->GetCount() );
+			return;
+		}
+		// 不存在的键交给原型链，toString等仍然可用
+		const CSharedData* pItem = pData->Find( *strName );
+		if( pItem )
+			info.GetReturnValue().Set( pContext->NewSharedData( pItem ) );
+	}
+
+	void SV8Context::SharedNamedSetter( v8::Local<v8::Name> property, LocalValue value,
+		const v8::PropertyCallbackInfo<v8::Value>& info )
+	{
+		ThrowReadOnly( info.GetIsolate() );
+		info.GetReturnValue().Set( value );
+	}
+
+	void SV8Context::SharedNamedDeleter( v8::Local<v8::Name> property, 
+		const v8::PropertyCallbackInfo<v8::Boolean>& info )
+	{
+		ThrowReadOnly( info.GetIsolate() );
+		info.GetReturnValue().Set( false );
+	}
+
+	void SV8Context::SharedNamedEnumerator( const v8::PropertyCallbackInfo<v8::Array>& info )
+	{
+		const CSharedData* pData = GetSharedData( info.Holder() );
+		if( pData->GetType() != CSharedData::eType_Map )
+			return;
+		v8::Isolate* isolate = info.GetIsolate();
+		v8::Local<v8::Context> context = isolate->GetCurrentContext();
+		v8::Local<v8::Array> Keys = v8::Array::New( isolate, (int)pData->GetCount() );
+		for( uint32 i = 0; i < pData->GetCount(); i++ )
+		{
+			if( Keys->Set( context, i, v8::String::NewFromUtf8( isolate, pData->GetKey( i ) ) ).IsNothing() )
+				return;
+		}
+		info.GetReturnValue().Set( Keys );
+	}
+
+	void SV8Context::SharedIndexedGetter( uint32_t nIndex, 
+		const v8::PropertyCallbackInfo<v8::Value>& info )
+	{
+		const CSharedData* pData = GetSharedData( info.Holder() );
+		if( pData->GetType() != CSharedData::eType_Array || nIndex >= pData->GetCount() )
+			return;
+		SV8Context* pContext = GetSharedContext( info.Data() );
+		info.GetReturnValue().Set( pContext->NewSharedData( pData->GetItem( nIndex ) ) );
+	}
+
+	void SV8Context::SharedIndexedSetter( uint32_t, LocalValue value,
+		const v8::PropertyCallbackInfo<v8::Value>& info )
+	{
+		ThrowReadOnly( info.GetIsolate() );
+		info.GetReturnValue().Set( value );
+	}
+
+	void SV8Context::SharedIndexedDeleter( uint32_t, 
+		const v8::PropertyCallbackInfo<v8::Boolean>& info )
+	{
+		ThrowReadOnly( info.GetIsolate() );
+		info.GetReturnValue().Set( false );
+	}
+
+	void SV8Context::SharedIndexedEnumerator( const v8::PropertyCallbackInfo<v8::Array>& info )
+	{
+		const CSharedData* pData = GetSharedData( info.Holder() );
+		if( pData->GetType() != CSharedData::eType_Array )
+			return;
+		v8::Isolate* isolate = info.GetIsolate();
+		v8::Local<v8::Context> context = isolate->GetCurrentContext();
+		v8::Local<v8::Array> Keys = v8::Array::New( isolate, (int)pData->GetCount() );
+		for( uint32 i = 0; i < pData->GetCount(); i++ )
+		{
+			if( Keys->Set( context, i, v8::Integer::NewFromUnsigned( isolate, i ) ).IsNothing() )
+				return;
+		}
+		info.GetReturnValue().Set( Keys );
+	}
+
+	//=====================================================================
+	// 二进制序列化，格式见CScriptSerial.h
+	//=====================================================================
+	bool SV8Context::SerializeValue( LocalValue Value, CSerialWriter& Writer, 
+		v8::Local<v8::Map> Visited, uint32 nDepth )
+	{
+		if( Value->IsUndefined() || Value->IsNull() )
+		{
+			Writer.WriteTag( eSerial_Nil );
+			return true;
+		}
+		if( Value->IsBoolean() )
+		{
+			Writer.WriteTag( Value->IsTrue() ? eSerial_True : eSerial_False );
+			return true;
+		}
+		if( Value->IsNumber() )
+		{
+			Writer.WriteNumber( v8::Local<v8::Number>::Cast( Value )->Value() );
+			return true;
+		}
+		if( Value->IsBigInt() )
+		{
+			// 超出int64的按uint64写入位模式，和Lua的无符号装箱整数一致，更大的不能序列化
+			v8::Local<v8::BigInt> BigInt = v8::Local<v8::BigInt>::Cast( Value );
+			bool bLossless = false;
+			int64 nValue = BigInt->Int64Value( &bLossless );
+			if( !bLossless )
+				nValue = (int64)BigInt->Uint64Value( &bLossless );
+			if( !bLossless )
+				return false;
+			Writer.WriteInt( nValue );
+			return true;
+		}
+		if( Value->IsString() )
+		{
+			v8::String::Utf8Value strValue( m_pIsolate, Value );
+			Writer.WriteString( *strValue, strValue.length() );
+			return true;
+		}
+
+		if( !Value->IsObject() || Value->IsFunction() || nDepth >= eSerial_MaxDepth )
+			return false;
+
+		v8::Local<v8::Context> context = m_pIsolate->GetCurrentContext();
+		v8::Local<v8::Object> Object = v8::Local<v8::Object>::Cast( Value );
+		if( Object->InternalFieldCount() == eBindField_Count )
+			return false;
+
+		// 写过的对象只写引用，共享的对象和循环引用都能还原
+		LocalValue Index;
+		if( !Visited->Get( context, Object ).ToLocal( &Index ) )
+			return false;
+		if( Index->IsNumber() )
+		{
+			Writer.WriteRef( (uint32)v8::Local<v8::Number>::Cast( Index )->Value() );
+			return true;
+		}
+		if( Visited->Set( context, Object, v8::Integer::NewFromUnsigned( 
+			m_pIsolate, (uint32)Visited->Size() ) ).IsEmpty() )
+			return false;
+
+		if( Value->IsArray() )
+		{
+			v8::Local<v8::Array> Array = v8::Local<v8::Array>::Cast( Value );
+			uint32 nCount = Array->Length();
+			Writer.WriteContainer( eSerial_Array, nCount );
+			for( uint32 i = 0; i < nCount; i++ )
+			{
+				LocalValue Item;
+				if( !Array->Get( context, i ).ToLocal( &Item ) ||
+					!SerializeValue( Item, Writer, Visited, nDepth + 1 ) )
+					return false;
+			}
+			return true;
+		}
+
+		v8::Local<v8::Array> Keys;
+		if( !Object->GetOwnPropertyNames( context ).ToLocal( &Keys ) )
+			return false;
+		uint32 nCount = Keys->Length();
+		Writer.WriteContainer( eSerial_Map, nCount );
+		for( uint32 i = 0; i < nCount; i++ )
+		{
+			LocalValue Key, Item;
+			if( !Keys->Get( context, i ).ToLocal( &Key ) ||
+				!Object->Get( context, Key ).ToLocal( &Item ) ||
+				!SerializeValue( Key, Writer, Visited, nDepth + 1 ) ||
+				!SerializeValue( Item, Writer, Visited, nDepth + 1 ) )
+				return false;
+		}
+		return true;
+	}
+
+	bool SV8Context::DeserializeValue( CSerialReader& Reader, LocalValue& Value, 
+		std::vector<v8::Local<v8::Object>>& vecLoaded, uint32 nDepth )
+	{
+		ESerialTag eTag;
+		if( nDepth >= eSerial_MaxDepth || !Reader.ReadTag( eTag ) )
+			return false;
+
+		v8::Local<v8::Context> context = m_pIsolate->GetCurrentContext();
+		double fValue;
+		const char* szValue;
+		uint32 nCount;
+		switch( eTag )
+		{
+		case eSerial_Nil:
+			Value = v8::Null( m_pIsolate );
+			return true;
+		case eSerial_False:
+		case eSerial_True:
+			Value = v8::Boolean::New( m_pIsolate, eTag == eSerial_True );
+			return true;
+		case eSerial_Int:
+		{
+			int64 nValue;
+			if( !Reader.ReadInt( nValue ) )
+				return false;
+			Value = NewInt64ToJS( m_pIsolate, nValue, false );
+			return true;
+		}
+		case eSerial_Double:
+			if( !Reader.ReadDouble( fValue ) )
+				return false;
+			Value = v8::Number::New( m_pIsolate, fValue );
+			return true;
+		case eSerial_String:
+		{
+			v8::Local<v8::String> String;
+			if( !Reader.ReadString( szValue, nCount ) || !v8::String::NewFromUtf8( 
+				m_pIsolate, szValue, v8::NewStringType::kNormal, (int)nCount ).ToLocal( &String ) )
+				return false;
+			Value = String;
+			return true;
+		}
+		case eSerial_Array:
+		{
+			if( !Reader.ReadCount( nCount ) )
+				return false;
+			v8::Local<v8::Array> Array = v8::Array::New( m_pIsolate, (int)nCount );
+			vecLoaded.push_back( Array );
+			for( uint32 i = 0; i < nCount; i++ )
+			{
+				LocalValue Item;
+				if( !DeserializeValue( Reader, Item, vecLoaded, nDepth + 1 ) ||
+					!Array->Set( context, i, Item ).FromMaybe( false ) )
+					return false;
+			}
+			Value = Array;
+			return true;
+		}
+		case eSerial_Map:
+		{
+			if( !Reader.ReadCount( nCount ) )
+				return false;
+			v8::Local<v8::Object> Object = v8::Object::New( m_pIsolate );
+			vecLoaded.push_back( Object );
+			for( uint32 i = 0; i < nCount; i++ )
+			{
+				LocalValue Key, Item;
+				if( !DeserializeValue( Reader, Key, vecLoaded, nDepth + 1 ) ||
+					!DeserializeValue( Reader, Item, vecLoaded, nDepth + 1 ) ||
+					!Object->Set( context, Key, Item ).FromMaybe( false ) )
+					return false;
+			}
+			Value = Object;
+			return true;
+		}
+		case eSerial_Ref:
+			if( !Reader.ReadRef( nCount ) || nCount >= vecLoaded.size() )
+				return false;
+			Value = vecLoaded[nCount];
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool SV8Context::DeserializeBuffer( const void* pBuffer, size_t nSize, LocalValue& Value )
+	{
+		CSerialReader Reader( pBuffer, nSize );
+		std::vector<v8::Local<v8::Object>> vecLoaded;
+		return Reader.ReadVersion() && 
+			DeserializeValue( Reader, Value, vecLoaded, 0 ) && Reader.IsEnd();
+	}
+
+	bool SV8Context::SerializeBuffer( LocalValue Value, std::string& strBuffer )
+	{
+		size_t nOrgSize = strBuffer.size();
+		CSerialWriter Writer( strBuffer );
+		if( SerializeValue( Value, Writer, v8::Map::New( m_pIsolate ), 0 ) )
+			return true;
+		strBuffer.resize( nOrgSize );
+		return false;
+	}
+
+	void SV8Context::Serialize( const v8::FunctionCallbackInfo<v8::Value>& args )
+	{
+		v8::Local<v8::External> wrap = v8::Local<v8::External>::Cast( args.Data() );
+		CScriptJS* pScript = (CScriptJS*)wrap->Value();
+		v8::Isolate* isolate = args.GetIsolate();
+		v8::HandleScope scope( isolate );
+		std::string strBuffer;
+		if( !pScript->GetV8Context().SerializeBuffer( args[0], strBuffer ) )
+		{
+			isolate->ThrowException( v8::Exception::TypeError( 
+				v8::String::NewFromUtf8( isolate, "value can not be serialized" ) ) );
+			return;
+		}
+		v8::Local<v8::ArrayBuffer> Buffer = v8::ArrayBuffer::New( isolate, strBuffer.size() );
+		memcpy( Buffer->GetContents().Data(), strBuffer.c_str(), strBuffer.size() );
+		args.GetReturnValue().Set( Buffer );
+	}
+
+	void SV8Context::Deserialize( const v8::FunctionCallbackInfo<v8::Value>& args )
+	{
+		v8::Local<v8::External> wrap = v8::Local<v8::External>::Cast( args.Data() );
+		CScriptJS* pScript = (CScriptJS*)wrap->Value();
+		v8::Isolate* isolate = args.GetIsolate();
+		v8::EscapableHandleScope scope( isolate );
+
+		const tbyte* pBuffer = NULL;
+		size_t nSize = 0;
+		if( args[0]->IsArrayBufferView() )
+		{
+			v8::Local<v8::ArrayBufferView> View = v8::Local<v8::ArrayBufferView>::Cast( args[0] );
+			pBuffer = (const tbyte*)View->Buffer()->GetContents().Data() + View->ByteOffset();
+			nSize = View->ByteLength();
+		}
+		else if( args[0]->IsArrayBuffer() )
+		{
+			v8::Local<v8::ArrayBuffer> Buffer = v8::Local<v8::ArrayBuffer>::Cast( args[0] );
+			pBuffer = (const tbyte*)Buffer->GetContents().Data();
+			nSize = Buffer->ByteLength();
+		}
+
+		LocalValue Value;
+		if( !pBuffer || !pScript->GetV8Context().DeserializeBuffer( pBuffer, nSize, Value ) )
+		{
+			isolate->ThrowException( v8::Exception::TypeError( 
+				v8::String::NewFromUtf8( isolate, "invalid serialized data" ) ) );
+			return;
+		}
+		args.GetReturnValue().Set( scope.Escape( Value ) );
+	}
+
+	//=====================================================================
+	// 值类型与js对象整体转换，按注册的成员逐个调用存取函数
+	//=====================================================================
+	v8::Local<v8::Object> SV8Context::FieldsToObject( const CClassInfo* pInfo, char* pObj )
+	{
+		v8::Local<v8::Context> context = m_pIsolate->GetCurrentContext();
+		const CClassInfo::CFieldArray& vecField = pInfo->GetFields();
+		char* pDataBuf = (char*)alloca( pInfo->GetFieldBufferSize() );
+		v8::Local<v8::Object> Object = v8::Object::New( m_pIsolate );
+		for( size_t i = 0; i < vecField.size(); i++ )
+		{
+			const CMemberInfo* pMember = vecField[i].m_pMember;
+			if( !pMember->GetFunWrap() )
+				continue;
+			DataType nType = pMember->GetResultType();
+			char* pThis = pObj + vecField[i].m_nBaseOff;
+			LocalValue Value;
+			if( const CClassInfo* pMemberClass = CClassInfo::GetConvertibleClass( nType ) )
+			{
+				Value = FieldsToObject( pMemberClass, pThis + pMember->GetOffset() );
+			}
+			else
+			{
+				void* aryArg[2] = { &pThis, NULL };
+				pMember->Call( pDataBuf, aryArg, *m_pScript );
+				Value = GetJSTypeBase( nType )->ToVMValue( nType, *m_pScript, pDataBuf );
+				if( IsValueClass( nType ) )
+					( (const CClassInfo*)( ( nType >> 1 ) << 1 ) )->Destruct( m_pScript, pDataBuf );
+			}
+			Object->Set( context, StringFromUtf8( pMember->GetFunctionName().c_str() ), Value );
+		}
+		return Object;
+	}
+
+	void SV8Context::FieldsFromObject( const CClassInfo* pInfo, char* pObj, v8::Local<v8::Object> Object )
+	{
+		v8::Local<v8::Context> context = m_pIsolate->GetCurrentContext();
+		const CClassInfo::CFieldArray& vecField = pInfo->GetFields();
+		char* pDataBuf = (char*)alloca( pInfo->GetFieldBufferSize() );
+		for( size_t i = 0; i < vecField.size(); i++ )
+		{
+			const CMemberInfo* pMember = vecField[i].m_pMember;
+			if( !pMember->GetFunSet() )
+				continue;
+
+			// 对象里没有的字段保持原值
+			LocalValue Value;
+			v8::Local<v8::Value> Key = StringFromUtf8( pMember->GetFunctionName().c_str() );
+			if( !Object->Get( context, Key ).ToLocal( &Value ) || Value->IsUndefined() )
+				continue;
+
+			DataType nType = pMember->GetResultType();
+			char* pThis = pObj + vecField[i].m_nBaseOff;
+			const CClassInfo* pMemberClass = CClassInfo::GetConvertibleClass( nType );
+			if( pMemberClass && Value->IsObject() && 
+				v8::Local<v8::Object>::Cast( Value )->InternalFieldCount() != eBindField_Count )
+			{
+				FieldsFromObject( pMemberClass, pThis + pMember->GetOffset(), 
+					v8::Local<v8::Object>::Cast( Value ) );
+				continue;
+			}
+
+			GetJSTypeBase( nType )->FromVMValue( nType, *m_pScript, pDataBuf, Value );
+			void* aryArg[2] = { &pThis, IsValueClass( nType ) ? *(void**)pDataBuf : pDataBuf };
+			pMember->Call( NULL, aryArg, *m_pScript );
+		}
+	}
+
+	void SV8Context::ToTable( const v8::FunctionCallbackInfo<v8::Value>& args )
+	{
+		v8::Local<v8::External> wrap = v8::Local<v8::External>::Cast( args.Data() );
+		SJSClassInfo* pClassInfo = (SJSClassInfo*)wrap->Value();
+		const CClassInfo* pInfo = pClassInfo->m_pClassInfo;
+		CScriptJS* pScript = pClassInfo->m_pScript;
+		v8::Isolate* isolate = args.GetIsolate();
+		v8::HandleScope scope( isolate );
+		char* pObj = NULL;
+		CJSObject::GetInst().FromVMValue( ( (DataType)pInfo )|1, *pScript, (char*)&pObj, args.This() );
+		if( !pObj )
+		{
+			std::string strError = std::string( "ToTable: invalid " ) + pInfo->GetClassName().c_str() + " object";
+			isolate->ThrowException( v8::Exception::TypeError( 
+				v8::String::NewFromUtf8( isolate, strError.c_str() ) ) );
+			return;
+		}
+		args.GetReturnValue().Set( pScript->GetV8Context().FieldsToObject( pInfo, pObj ) );
+	}
+
+	void SV8Context::FromTable( const v8::FunctionCallbackInfo<v8::Value>& args )
+	{
+		v8::Local<v8::External> wrap = v8::Local<v8::External>::Cast( args.Data() );
+		SJSClassInfo* pClassInfo = (SJSClassInfo*)wrap->Value();
+		const CClassInfo* pInfo = pClassInfo->m_pClassInfo;
+		CScriptJS* pScript = pClassInfo->m_pScript;
+		v8::Isolate* isolate = args.GetIsolate();
+		v8::HandleScope scope( isolate );
+		char* pObj = NULL;
+		CJSObject::GetInst().FromVMValue( ( (DataType)pInfo )|1, *pScript, (char*)&pObj, args.This() );
+		if( !pObj )
+		{
+			std::string strError = std::string( "FromTable: invalid " ) + pInfo->GetClassName().c_str() + " object";
+			isolate->ThrowException( v8::Exception::TypeError( 
+				v8::String::NewFromUtf8( isolate, strError.c_str() ) ) );
+			return;
+		}
+		if( !args[0]->IsObject() )
+		{
+			isolate->ThrowException( v8::Exception::TypeError( 
+				v8::String::NewFromUtf8( isolate, "FromTable: object expected" ) ) );
+			return;
+		}
+		pScript->GetV8Context().FieldsFromObject( pInfo, pObj, v8::Local<v8::Object>::Cast( args[0] ) );
+		args.GetReturnValue().Set( args.This() );
+	}
+
 	void SV8Context::ReportException(v8::TryCatch* try_catch, v8::Local<v8::Context> context)
 	{
 		v8::Local<v8::Message> message = try_catch->Message();
@@ -215,15 +819,18 @@ namespace XS
 		CScriptJS* pScript = (CScriptJS*)wrap->Value();
 		v8::Isolate* isolate = args.GetIsolate();
 		v8::HandleScope scope( isolate );
+		// 整行一次输出，缓冲满时整行丢弃，不会只留下半行
+		std::string strLine;
 		for( int32 i = 0; i < args.Length(); i++ )
 		{
 			v8::Local<v8::Value> arg = args[i];
 			v8::String::Utf8Value value( isolate, arg );
-			const char* szValue = *value;
-			pScript->Output( szValue, -1 );
-			pScript->Output( " ", -1 );
+			if( *value )
+				strLine.append( *value, value.length() );
+			strLine.push_back( ' ' );
 		}
-		pScript->Output( "\n", -1 );
+		strLine.push_back( '\n' );
+		pScript->Output( strLine.c_str(), (int32)strLine.size() );
 	}
 
 	void SV8Context::Break( const v8::FunctionCallbackInfo<v8::Value>& args )
@@ -305,18 +912,22 @@ namespace XS
 		SV8Context& Context = Script.GetV8Context();
 		v8::Isolate* isolate = Context.m_pIsolate;
 		v8::Local<v8::Object> ScriptObj = args.This();
-		v8::External* pCppBind = NULL;
-		if( ScriptObj->InternalFieldCount() )
-			pCppBind = v8::External::Cast( *ScriptObj->GetInternalField( 0 ) );
-		else
+
+		// 普通对象没有内部字段，只能通过new或者super()构造
+		if( ScriptObj->InternalFieldCount() != eBindField_Count )
 		{
-			v8::Local<v8::Value> key = Context.m_CppField.Get( isolate );
-			v8::Local<v8::Context> context = isolate->GetCurrentContext();
-			v8::MaybeLocal<v8::Value> field = ScriptObj->Get( context, key );
-			pCppBind = v8::External::Cast( *( field.ToLocalChecked() ) );
+			isolate->ThrowException( v8::Exception::TypeError( v8::String::NewFromUtf8( 
+				isolate, "native class must be constructed by new or super()" ) ) );
+			return;
 		}
 
-		if( pCppBind->Value() )
+		// new出来的实例（包括super()构造的脚本派生类）内部字段还是undefined
+		if( args.IsConstructCall() )
+		{
+			ScriptObj->SetAlignedPointerInInternalField( eBindField_ObjInfo, NULL );
+			ScriptObj->SetAlignedPointerInInternalField( eBindField_Context, &Context );
+		}
+		else if( Context.GetObjInfo( *ScriptObj ) )
 		{
 			args.GetReturnValue().Set( ScriptObj );
 			return;
@@ -357,20 +968,7 @@ namespace XS
 		SJSClassInfo* pClassInfo = (SJSClassInfo*)wrap->Value();
 		CScriptJS& Script = *(CScriptJS*)pClassInfo->m_pScript;
 		SV8Context& Context = Script.GetV8Context();
-		v8::Isolate* isolate = Context.m_pIsolate;
-		v8::Object* pScriptObject = v8::Object::Cast( *args.This() );
-		v8::External* pCppBind = NULL;
-		if( pScriptObject->InternalFieldCount() )
-			pCppBind = v8::External::Cast( *pScriptObject->GetInternalField( 0 ) );
-		else
-		{
-			v8::Local<v8::Value> key = Context.m_CppField.Get( isolate );
-			v8::Local<v8::Context> context = isolate->GetCurrentContext();
-			v8::MaybeLocal<v8::Value> field = pScriptObject->Get( context, key );
-			pCppBind = v8::External::Cast( *( field.ToLocalChecked() ) );
-		}
-
-		SObjInfo* pObjectInfo = (SObjInfo*)pCppBind->Value();
+		SObjInfo* pObjectInfo = Context.GetObjInfo( *args.This() );
 		if( !pObjectInfo )
 			return;
 		Context.UnbindObj( pObjectInfo, false );
@@ -383,6 +981,32 @@ namespace XS
 		pInfo->m_pScript->GetV8Context().UnbindObj( pObjectInfo, true );
 	}
 
+	void SV8Context::LazyBindClass( v8::Local<v8::Name> property,
+		const v8::PropertyCallbackInfo<v8::Value>& info )
+	{
+		// kNonMasking，只有全局对象上不存在此属性时才会进来
+		v8::Local<v8::External> wrap = v8::Local<v8::External>::Cast( info.Data() );
+		CScriptJS* pScript = (CScriptJS*)wrap->Value();
+		v8::Isolate* isolate = info.GetIsolate();
+		v8::String::Utf8Value strName( isolate, property );
+		if( !*strName )
+			return;
+
+		auto it = pScript->m_mapClassPackage.find( *strName );
+		if( it == pScript->m_mapClassPackage.end() )
+			return;
+		const std::vector<const CClassInfo*>& vecClass = it->second;
+		for( size_t i = 0; i < vecClass.size(); i++ )
+			pScript->BindClass( vecClass[i] );
+
+		v8::Local<v8::Context> context = isolate->GetCurrentContext();
+		v8::MaybeLocal<v8::Value> value =
+			context->Global()->GetRealNamedProperty( context, property );
+		if( value.IsEmpty() )
+			return;
+		info.GetReturnValue().Set( value.ToLocalChecked() );
+	}
+
 	void SV8Context::GetterFromV8( v8::Local<v8::Name> property, 
 		const v8::PropertyCallbackInfo<v8::Value>& info )
 	{
@@ -460,26 +1084,27 @@ namespace XS
 	}
 
 	void SV8Context::BindObj( void* pObject, v8::Local<v8::Object> ScriptObj, 
-		const CClassInfo* pInfo, bool bRecycle )
+		const CClassInfo* pInfo, bool bRecycle, bool bValueCopy )
 	{
 		if( !pObject )
 			return;
 		SObjInfo& ObjectInfo = *m_pScript->AllocObjectInfo();
 		ObjectInfo.m_bRecycle = bRecycle;
+		ObjectInfo.m_nObjectStat = (uint8)( !bRecycle ? eObjStat_Bound : 
+			( bValueCopy ? eObjStat_ValueCopy : eObjStat_NewByVM ) );
+		m_pScript->AddObjectStat( pInfo, (EObjectStat)ObjectInfo.m_nObjectStat, 1 );
 		ObjectInfo.m_Object.Reset( m_pIsolate, ScriptObj );
-		ObjectInfo.m_pClassInfo = m_pScript->m_mapClassInfo.Find( (const void*)pInfo );
+		ObjectInfo.m_pClassInfo = m_pScript->BindClass( pInfo );
 		ObjectInfo.m_pObject = pObject;
-		m_pScript->m_mapObjInfo.Insert( ObjectInfo );
+		m_pScript->InsertObjectInfo( &ObjectInfo );
 
 		// 注册回调函数
 		if( pInfo->IsCallBack() )
 			pInfo->ReplaceVirtualTable( m_pScript, pObject, ObjectInfo.m_bRecycle, 0 );
 
-		v8::Local<v8::External> cppInfo = v8::External::New( m_pIsolate, &ObjectInfo );
-		if( ScriptObj->InternalFieldCount() )
-			ScriptObj->SetInternalField( 0, cppInfo );
-		else
-			ScriptObj->Set( m_pIsolate->GetCurrentContext(), m_CppField.Get( m_pIsolate ), cppInfo );
+		assert( ScriptObj->InternalFieldCount() == eBindField_Count );
+		ScriptObj->SetAlignedPointerInInternalField( eBindField_ObjInfo, &ObjectInfo );
+		ScriptObj->SetAlignedPointerInInternalField( eBindField_Context, this );
 		ObjectInfo.m_Object.SetWeak( &ObjectInfo, 
 			&SV8Context::GCCallback, v8::WeakCallbackType::kParameter );
 	}
@@ -496,20 +1121,18 @@ namespace XS
 		{
 			v8::Local<v8::Object> ScriptObj = pObjectInfo->m_Object.Get( m_pIsolate );
 			assert( !ScriptObj.IsEmpty()&&ScriptObj->IsObject() );
-			if( ScriptObj->InternalFieldCount() )
-				ScriptObj->SetInternalField( 0, v8::Null( m_pIsolate ) );
-			else
-				ScriptObj->Set( m_pIsolate->GetCurrentContext(), 
-					m_CppField.Get( m_pIsolate ), v8::Null( m_pIsolate ) );
+			ScriptObj->SetAlignedPointerInInternalField( eBindField_ObjInfo, NULL );
 		}
 
-		pObjectInfo->Remove();
+		m_pScript->RemoveObjectInfo( pObjectInfo );
 		pObjectInfo->m_pObject = NULL;
 		pObjectInfo->m_Object.Reset();
 
+		EObjectStat eStat = (EObjectStat)pObjectInfo->m_nObjectStat;
 		m_pScript->FreeObjectInfo( pObjectInfo );
 		if( !pObject )
 			return;
+		m_pScript->AddObjectStat( pInfo, eStat, -1 );
 		pInfo->RecoverVirtualTable( m_pScript, pObject );
 		if( !bRecycle )
 			return;
@@ -1,8 +1,14 @@
 #ifndef __V8CONTEXT_H__
 #define __V8CONTEXT_H__
 #include "v8/v8.h"
+#include "v8/v8-profiler.h"
 #include "common/TRBTree.h"
 #include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 //=====================================================================
 // V8Context.h 
@@ -16,6 +22,9 @@ namespace XS
 	class CScriptJS;
 	class CCallInfo;
 	class CClassInfo;
+	class CSharedData;
+	class CSerialWriter;
+	class CSerialReader;
 
 	typedef v8::Persistent<v8::Context>						PersistentContext;
 	typedef v8::Persistent<v8::ObjectTemplate>				PersistentObjTmplt;
@@ -23,9 +32,12 @@ namespace XS
 	typedef v8::Persistent<v8::Object>						PersistentObject;
 	typedef v8::Persistent<v8::String>						PersistentString;
 	typedef v8::Persistent<v8::Function>					PersistentFunction;
+	typedef v8::Persistent<v8::UnboundScript>				PersistentScript;
 	typedef v8::Local<v8::Value>							LocalValue;
 	typedef v8::ReturnValue<v8::Value>						ReturnValue;
 	typedef std::map<void*, PersistentString>				StringCacheMap;
+	typedef std::map<std::string, PersistentScript>			ScriptCacheMap;
+	typedef std::map<const CSharedData*, PersistentObject>	SharedDataMap;
 
 	struct SJSClassInfo : public TRBTree<SJSClassInfo>::CRBTreeNode
 	{
@@ -43,6 +55,7 @@ namespace XS
 		SJSClassInfo*			m_pClassInfo;
 		bool					m_bRecycle;
 		bool					m_bFirstAddress;
+		uint8					m_nObjectStat;
 		operator void*() { return m_pObject; }
 		bool operator< (void* r) { return m_pObject < r; }
 	};
@@ -68,6 +81,14 @@ namespace XS
 		void*					m_pStack;
 	};
 
+	/// 󶨶ڲֶΣֶҲڲֶεĶ
+	enum EBindField
+	{
+		eBindField_ObjInfo,
+		eBindField_Context,
+		eBindField_Count
+	};
+
 	struct SV8Context
 	{
 		SV8Context( CScriptJS* pScript );
@@ -85,16 +106,25 @@ namespace XS
 		PersistentContext			m_Context;
 		PersistentObject			m_XSNameSpace;
 		PersistentFunction			m_XSClass;
-		PersistentString			m_CppField;
-		PersistentString			m_Prototype;
 		PersistentString			m_Deconstruction;
-		PersistentString			m___proto__;
+		ScriptCacheMap				m_mapChunkCache;
+		v8::CpuProfiler*			m_pCpuProfiler;
+		PersistentObjTmplt			m_SharedDataTemplate;
+		SharedDataMap				m_mapSharedData;
+
+		std::thread					m_hWatchdog;
+		std::mutex					m_hWatchdogLock;
+		std::condition_variable		m_hWatchdogSignal;
+		std::chrono::steady_clock::time_point m_tWatchdogDeadline;
+		bool						m_bWatchdogArmed;
+		bool						m_bWatchdogQuit;
+		bool						m_bWatchdogFired;
 
 		void						MakeMeberFunction(const CClassInfo* pInfo, 
 										v8::Local<v8::Function> NewClass, 
 										v8::Local<v8::Object> Prototype, bool bBase);
 		void						BindObj(void* pObject, v8::Local<v8::Object> ScriptObj, 
-										const CClassInfo* pInfo, bool bRecycle );
+										const CClassInfo* pInfo, bool bRecycle, bool bValueCopy = false );
 		void						UnbindObj( SObjInfo* pObjectInfo, bool bFromGC );
 
 		v8::Local<v8::Value>		StringFromUtf8(const char* szUtf8);
@@ -103,14 +133,58 @@ namespace XS
 		const wchar_t*				StringToUcs(v8::Local<v8::Value> obj);
 		void						ClearCppString(void* pStack);
 		void						CallJSStatck(bool bAdd);
-
+		void						StartWatchdog(std::chrono::steady_clock::time_point tDeadline);
+		bool						StopWatchdog();
+		void						ShutdownWatchdog();
+		void						WatchdogRun();
+
+		LocalValue					NewSharedData( const CSharedData* pData );
+		void						ClearSharedData();
+		bool						SerializeValue( LocalValue Value, CSerialWriter& Writer, 
+									v8::Local<v8::Map> Visited, uint32 nDepth );
+		bool						DeserializeValue( CSerialReader& Reader, LocalValue& Value, 
+									std::vector<v8::Local<v8::Object>>& vecLoaded, uint32 nDepth );
+		bool						SerializeBuffer( LocalValue Value, std::string& strBuffer );
+		bool						DeserializeBuffer( const void* pBuffer, size_t nSize, LocalValue& Value );
+		v8::Local<v8::Object>		FieldsToObject( const CClassInfo* pInfo, char* pObj );
+		void						FieldsFromObject( const CClassInfo* pInfo, char* pObj, v8::Local<v8::Object> Object );
 		void						ReportException( v8::TryCatch* try_catch, v8::Local<v8::Context> context );
 
+		/// ֻɱİ󶨵ĶĻڲֶεĶ󷵻NULL
+		SObjInfo*					GetObjInfo( v8::Object* pObject ) const
+		{
+			if( pObject->InternalFieldCount() != eBindField_Count ||
+				pObject->GetAlignedPointerFromInternalField( eBindField_Context ) != this )
+				return NULL;
+			return (SObjInfo*)pObject->GetAlignedPointerFromInternalField( eBindField_ObjInfo );
+		}
+
 		static void					Log(const v8::FunctionCallbackInfo<v8::Value>& args);
 		static void					Break(const v8::FunctionCallbackInfo<v8::Value>& args);
+		static void					Serialize(const v8::FunctionCallbackInfo<v8::Value>& args);
+		static void					Deserialize(const v8::FunctionCallbackInfo<v8::Value>& args);
+		static void					ToTable(const v8::FunctionCallbackInfo<v8::Value>& args);
+		static void					FromTable(const v8::FunctionCallbackInfo<v8::Value>& args);
 		static void					NewObject(const v8::FunctionCallbackInfo<v8::Value>& args);
 		static void					Destruction(const v8::FunctionCallbackInfo<v8::Value>& args);
 		static void					GCCallback(const v8::WeakCallbackInfo<SObjInfo>& data);
+		static void					LazyBindClass(v8::Local<v8::Name> property, 
+											const v8::PropertyCallbackInfo<v8::Value>& info);
+		static void					SharedNamedGetter(v8::Local<v8::Name> property, 
+											const v8::PropertyCallbackInfo<v8::Value>& info);
+		static void					SharedNamedSetter(v8::Local<v8::Name> property, LocalValue value,
+											const v8::PropertyCallbackInfo<v8::Value>& info);
+		static void					SharedNamedDeleter(v8::Local<v8::Name> property, 
+											const v8::PropertyCallbackInfo<v8::Boolean>& info);
+		static void					SharedNamedEnumerator(const v8::PropertyCallbackInfo<v8::Array>& info);
+		static void					SharedIndexedGetter(uint32_t nIndex, 
+											const v8::PropertyCallbackInfo<v8::Value>& info);
+		static void					SharedIndexedSetter(uint32_t nIndex, LocalValue value,
+											const v8::PropertyCallbackInfo<v8::Value>& info);
+		static void					SharedIndexedDeleter(uint32_t nIndex, 
+											const v8::PropertyCallbackInfo<v8::Boolean>& info);
+		static void					SharedIndexedEnumerator(const v8::PropertyCallbackInfo<v8::Array>& info);
+		static void					SharedDataGCCallback(const v8::WeakCallbackInfo<SV8Context>& data);
 
 		static void					CallFromV8(const v8::FunctionCallbackInfo<v8::Value>& args);
 		static void					GetterFromV8(v8::Local<v8::Name> property, 